@@ -1016,8 +1016,10 @@ void verifyAttributes(ExternalProcedurePtr x)
     x->attributesVerified = true;
     x->attrDLLImport = false;
     x->attrDLLExport = false;
+    x->attrMultiversion = false;
     int callingConv = -1;
     x->attrAsmLabel = "";
+    x->attrMultiversionFeatures.clear();
 
     MultiStaticPtr attrs = evaluateMultiStatic(x->attributes, x->env);
 
@@ -1070,6 +1072,12 @@ void verifyAttributes(ExternalProcedurePtr x)
                 x->attrDLLExport = true;
                 break;
             }
+            case PRIM_AttributeMultiversion : {
+                if (x->attrMultiversion)
+                    error(x, "multiversion specified more than once in external attributes");
+                x->attrMultiversion = true;
+                break;
+            }
             default : {
                 string buf;
                 llvm::raw_string_ostream os(buf);
@@ -1081,8 +1089,12 @@ void verifyAttributes(ExternalProcedurePtr x)
             break;
         }
         case IDENTIFIER : {
+            // strings following `multiversion` are its feature sets
             Identifier *y = (Identifier *)obj.ptr();
-            x->attrAsmLabel = y->str;
+            if (x->attrMultiversion)
+                x->attrMultiversionFeatures.push_back(y->str.str());
+            else
+                x->attrAsmLabel = y->str;
             break;
         }
         default: {
@@ -1097,6 +1109,15 @@ void verifyAttributes(ExternalProcedurePtr x)
     if (callingConv == -1)
         callingConv = CC_DEFAULT;
     x->callingConv = (CallingConv)callingConv;
+
+    if (x->attrMultiversion) {
+        if (x->attrMultiversionFeatures.empty())
+            error(x, "multiversion requires at least one feature set in external attributes");
+        if (!x->body)
+            error(x, "multiversion external procedures must have a body");
+        if (x->attrDLLImport)
+            error(x, "multiversion external procedures cannot be dllimport");
+    }
 }
 
 void verifyAttributes(ExternalVariablePtr var)
@@ -2,9 +2,12 @@
 #include "hirestimer.hpp"
 #include "error.hpp"
 #include "codegen.hpp"
+#include "depgraph.hpp"
 #include "loader.hpp"
 #include "invoketables.hpp"
 #include "parachute.hpp"
+#include "pgo.hpp"
+#include "multiversion.hpp"
 
 // for _exit
 #ifdef _WIN32
@@ -135,6 +138,8 @@ static void addOptimizationPasses(llvm::PassManager &passes,
         if (internalize) {
             vector<const char*> do_not_internalize;
             do_not_internalize.push_back("main");
+            for (size_t i = 0; i < multiversionSharedGlobals.size(); ++i)
+                do_not_internalize.push_back(multiversionSharedGlobals[i].c_str());
             passes.add(llvm::createInternalizePass(do_not_internalize));
         }
         builder.populateLTOPassManager(passes, false, true);
@@ -201,17 +206,28 @@ static bool linkLibraries(llvm::Module *module, llvm::ArrayRef<string>  libSearc
     return true;
 }
 
+// the JIT's lazy compilation stubs are not thread-safe, so a program that
+// can start threads is compiled in full before it runs
+static bool startsThreads(llvm::Module *module)
+{
+    return module->getFunction("pthread_create") != NULL
+        || module->getFunction("CreateThread") != NULL;
+}
+
 static bool runModule(llvm::Module *module,
                       vector<string> &argv,
                       char const* const* envp,
                       llvm::ArrayRef<string>  libSearchPaths,
-                      llvm::ArrayRef<string>  libs)
+                      llvm::ArrayRef<string>  libs,
+                      bool lazyCompilation)
 {
     if (!linkLibraries(module, libSearchPaths, libs)) {
         return false;
     }
-    llvm::EngineBuilder eb(llvmModule);
+    llvm::EngineBuilder eb(module);
     llvm::ExecutionEngine *engine = eb.create();
+    // otherwise only procedures that are actually called get compiled
+    engine->DisableLazyCompilation(!lazyCompilation || startsThreads(module));
     llvm::Function *mainFunc = module->getFunction("main");
     if (!mainFunc) {
         llvm::errs() << "no main function to -run\n";
@@ -226,6 +242,143 @@ static bool runModule(llvm::Module *module,
     return true;
 }
 
+//
+// -run-cache-dir: the optimized module of a -run or -e program is saved as
+// <key>.bc along with <key>.sources, which lists the hash of every source
+// file it was compiled from and the file each imported module was found
+// in. While those files are unchanged and every import still resolves to
+// the same file (a module added earlier in the search path, or a platform
+// specific variant, would be loaded instead), running with the same
+// arguments loads the bitcode instead of compiling again.
+//
+
+static string runCacheKey(int argc, char **argv, llvm::StringRef targetTriple,
+                          llvm::ArrayRef<PathString> searchPath)
+{
+    uint64_t hash = fnv1aHash(FNV1A_OFFSET, CLAY_COMPILER_VERSION);
+    hash = fnv1aHash(hash, targetTriple);
+    // relative paths and the module search path, which also depends on
+    // CLAY_PATH and where the compiler is installed, change which files
+    // get loaded
+    PathString cwd;
+    if (!llvm::sys::fs::current_path(cwd))
+        hash = fnv1aHash(hash, cwd);
+    for (size_t i = 0; i < searchPath.size(); ++i) {
+        hash = fnv1aHash(hash, llvm::StringRef("\0", 1));
+        hash = fnv1aHash(hash, searchPath[i]);
+    }
+    for (int i = 1; i < argc; ++i) {
+        hash = fnv1aHash(hash, llvm::StringRef("\0", 1));
+        hash = fnv1aHash(hash, argv[i]);
+    }
+    return llvm::utohexstr(hash);
+}
+
+static bool sourceHash(llvm::StringRef fileName, string &hash)
+{
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    if (llvm::MemoryBuffer::getFile(fileName, buffer))
+        return false;
+    hash = llvm::utohexstr(fnv1aHash(FNV1A_OFFSET, buffer->getBuffer()));
+    return true;
+}
+
+static PathString runCachePath(llvm::StringRef cacheDir, llvm::StringRef key,
+                               llvm::StringRef extension)
+{
+    PathString path(cacheDir);
+    llvm::sys::path::append(path, key + extension);
+    return path;
+}
+
+static llvm::Module *loadRunCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                                  bool verbose)
+{
+    llvm::OwningPtr<llvm::MemoryBuffer> sources;
+    if (llvm::MemoryBuffer::getFile(runCachePath(cacheDir, key, ".sources"), sources))
+        return NULL;
+
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    sources->getBuffer().split(lines, "\n", -1, false);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::pair<llvm::StringRef, llvm::StringRef> entry = lines[i].split(' ');
+        if (entry.first == "module") {
+            std::pair<llvm::StringRef, llvm::StringRef> module = entry.second.split(' ');
+            string path;
+            if (!locateModuleFile(module.first, path) || path != module.second) {
+                if (verbose)
+                    llvm::errs() << "run cache: module " << module.first
+                                 << " is found elsewhere\n";
+                return NULL;
+            }
+            continue;
+        }
+        string hash;
+        if (!sourceHash(entry.second, hash) || hash != entry.first) {
+            if (verbose)
+                llvm::errs() << "run cache: " << entry.second << " has changed\n";
+            return NULL;
+        }
+    }
+
+    llvm::OwningPtr<llvm::MemoryBuffer> bitcode;
+    if (llvm::MemoryBuffer::getFile(runCachePath(cacheDir, key, ".bc"), bitcode))
+        return NULL;
+    string errorMessage;
+    llvm::Module *module = llvm::ParseBitcodeFile(
+        bitcode.get(), llvm::getGlobalContext(), &errorMessage);
+    if (module == NULL && verbose)
+        llvm::errs() << "run cache: " << errorMessage << "\n";
+    else if (verbose)
+        llvm::errs() << "run cache: using " << key << ".bc\n";
+    return module;
+}
+
+static void writeRunCache(llvm::StringRef cacheDir, llvm::StringRef key,
+                          llvm::Module *module,
+                          llvm::ArrayRef<string> sourceFiles,
+                          bool verbose)
+{
+    bool existed;
+    if (llvm::error_code ec = llvm::sys::fs::create_directories(cacheDir, existed)) {
+        if (verbose)
+            llvm::errs() << "run cache: " << cacheDir << ": " << ec.message() << "\n";
+        return;
+    }
+
+    string errorInfo;
+    {
+        llvm::raw_fd_ostream out(runCachePath(cacheDir, key, ".bc").c_str(),
+                                 errorInfo, llvm::raw_fd_ostream::F_Binary);
+        if (!errorInfo.empty()) {
+            if (verbose)
+                llvm::errs() << "run cache: " << errorInfo << "\n";
+            return;
+        }
+        llvm::WriteBitcodeToFile(module, out);
+    }
+
+    // written last, so that a listing always refers to complete bitcode
+    llvm::raw_fd_ostream out(runCachePath(cacheDir, key, ".sources").c_str(),
+                             errorInfo);
+    if (!errorInfo.empty()) {
+        if (verbose)
+            llvm::errs() << "run cache: " << errorInfo << "\n";
+        return;
+    }
+    for (size_t i = 0; i < sourceFiles.size(); ++i) {
+        string hash;
+        if (sourceHash(sourceFiles[i], hash))
+            out << hash << ' ' << sourceFiles[i] << '\n';
+    }
+    llvm::StringMap<ModulePtr>::const_iterator i, end;
+    for (i = globalModules.begin(), end = globalModules.end(); i != end; ++i) {
+        if (i->second->source != NULL)
+            out << "module " << i->getKey() << ' '
+                << i->second->source->fileName << '\n';
+    }
+}
+
 static void optimizeLLVM(llvm::Module *module, unsigned optLevel, bool internalize)
 {
     llvm::PassManager passes;
@@ -251,6 +404,181 @@ static void optimizeLLVM(llvm::Module *module, unsigned optLevel, bool internali
     passes.run(*module);
 }
 
+// -Ofast-compile keeps codegen's stack temporaries out of instruction
+// selection by promoting them to registers, which is all that -O0 needs to
+// stop spilling every intermediate value
+static void promoteTemporaries(llvm::Module *module)
+{
+    llvm::FunctionPassManager fpasses(module);
+
+    fpasses.add(new llvm::DataLayout(module));
+    fpasses.add(llvm::createPromoteMemoryToRegisterPass());
+
+    fpasses.doInitialization();
+    for (llvm::Module::iterator i = module->begin(), e = module->end();
+         i != e; ++i)
+    {
+        fpasses.run(*i);
+    }
+    fpasses.doFinalization();
+}
+
+static unsigned instructionCount(llvm::Function &f)
+{
+    unsigned count = 0;
+    for (llvm::Function::iterator bb = f.begin(); bb != f.end(); ++bb)
+        count += bb->size();
+    return count;
+}
+
+// Instantiations whose argument types share a representation (pointers to
+// different types, equally sized integers) often produce identical bodies.
+// Merge them before optimization, optionally reporting what was folded
+// for each callable.
+static void mergeIdenticalFunctions(llvm::Module *module, bool report)
+{
+    vector<pair<string, unsigned> > sizes;
+    for (llvm::Module::iterator f = module->begin(); f != module->end(); ++f) {
+        if (!f->isDeclaration() && f->hasLocalLinkage())
+            sizes.push_back(make_pair(f->getName().str(), instructionCount(*f)));
+    }
+
+    llvm::PassManager passes;
+    passes.add(new llvm::DataLayout(module->getDataLayout()));
+    passes.add(llvm::createMergeFunctionsPass());
+    passes.run(*module);
+
+    if (!report)
+        return;
+
+    // callable name -> (functions folded, instructions removed)
+    map<string, pair<unsigned, unsigned> > folded;
+    unsigned totalFunctions = 0, totalInstructions = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        llvm::Function *f = module->getFunction(sizes[i].first);
+        unsigned after = (f != NULL) ? instructionCount(*f) : 0;
+        if (after >= sizes[i].second)
+            continue;
+        string callable = sizes[i].first.substr(0, sizes[i].first.find('('));
+        pair<unsigned, unsigned> &entry = folded[callable];
+        entry.first += 1;
+        entry.second += sizes[i].second - after;
+        totalFunctions += 1;
+        totalInstructions += sizes[i].second - after;
+    }
+    for (map<string, pair<unsigned, unsigned> >::const_iterator i = folded.begin();
+         i != folded.end(); ++i)
+    {
+        llvm::errs() << "merged " << i->second.first << " instance(s) of "
+                     << i->first << ", " << i->second.second
+                     << " instruction(s) removed\n";
+    }
+    llvm::errs() << "merged " << totalFunctions << " function(s), "
+                 << totalInstructions << " instruction(s) removed\n";
+}
+
+// Bitcode written with -emit-llvm carries this marker; -lto only accepts
+// marked inputs. The symbols that the module defines for use from outside
+// the program (those of `external` definitions) are listed alongside, so
+// that -lto can keep them when it internalizes everything else.
+static void markModuleForLTO(llvm::Module *module)
+{
+    llvm::LLVMContext &context = module->getContext();
+    llvm::NamedMDNode *marker = module->getOrInsertNamedMetadata("clay.lto");
+    if (marker->getNumOperands() == 0) {
+        llvm::Value *version = llvm::MDString::get(context, "1");
+        marker->addOperand(llvm::MDNode::get(context, version));
+    }
+
+    if (llvm::NamedMDNode *old = module->getNamedMetadata("clay.lto.exports"))
+        old->eraseFromParent();
+    llvm::NamedMDNode *exports = module->getOrInsertNamedMetadata("clay.lto.exports");
+    for (llvm::Module::iterator f = module->begin(); f != module->end(); ++f) {
+        if (!f->isDeclaration() && !f->hasLocalLinkage())
+            exports->addOperand(llvm::MDNode::get(
+                context, llvm::MDString::get(context, f->getName())));
+    }
+    for (llvm::Module::global_iterator g = module->global_begin();
+         g != module->global_end(); ++g)
+    {
+        if (!g->isDeclaration() && !g->hasLocalLinkage()
+            && !g->getName().startswith("llvm."))
+            exports->addOperand(llvm::MDNode::get(
+                context, llvm::MDString::get(context, g->getName())));
+    }
+}
+
+static bool linkModulesForLTO(llvm::Module *module,
+                              llvm::ArrayRef<string> inputFiles,
+                              bool verbose)
+{
+    for (size_t i = 0; i < inputFiles.size(); ++i) {
+        if (verbose)
+            llvm::errs() << "linking " << inputFiles[i] << "\n";
+
+        llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+        if (llvm::error_code ec = llvm::MemoryBuffer::getFile(inputFiles[i], buffer)) {
+            llvm::errs() << "error: unable to open " << inputFiles[i]
+                         << ": " << ec.message() << '\n';
+            return false;
+        }
+        string errorMessage;
+        llvm::OwningPtr<llvm::Module> input(
+            llvm::ParseBitcodeFile(buffer.get(), module->getContext(), &errorMessage));
+        if (!input) {
+            llvm::errs() << "error: " << inputFiles[i] << ": " << errorMessage << '\n';
+            return false;
+        }
+        if (input->getNamedMetadata("clay.lto") == NULL) {
+            llvm::errs() << "error: " << inputFiles[i]
+                         << " was not generated by clay -emit-llvm\n";
+            return false;
+        }
+        if (llvm::Linker::LinkModules(module, input.get(),
+                                      llvm::Linker::DestroySource, &errorMessage))
+        {
+            llvm::errs() << "error: linking " << inputFiles[i]
+                         << ": " << errorMessage << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+// When linking an executable, everything but `main`, the inputs' exported
+// symbols and dllexport symbols is only referenced from within the program,
+// so the optimizer may inline and drop it freely.
+static void internalizeForLTO(llvm::Module *module)
+{
+    vector<string> keep;
+    keep.push_back("main");
+    if (llvm::NamedMDNode *exports = module->getNamedMetadata("clay.lto.exports")) {
+        for (unsigned i = 0; i < exports->getNumOperands(); ++i) {
+            llvm::MDString *name =
+                llvm::cast<llvm::MDString>(exports->getOperand(i)->getOperand(0));
+            keep.push_back(name->getString());
+        }
+    }
+    for (llvm::Module::iterator f = module->begin(); f != module->end(); ++f) {
+        if (f->hasDLLExportLinkage())
+            keep.push_back(f->getName());
+    }
+    for (llvm::Module::global_iterator g = module->global_begin();
+         g != module->global_end(); ++g)
+    {
+        if (g->hasDLLExportLinkage())
+            keep.push_back(g->getName());
+    }
+
+    llvm::PassManager passes;
+    vector<const char*> do_not_internalize;
+    for (size_t i = 0; i < keep.size(); ++i)
+        do_not_internalize.push_back(keep[i].c_str());
+    passes.add(llvm::createInternalizePass(do_not_internalize));
+    passes.add(llvm::createGlobalDCEPass());
+    passes.run(*module);
+}
+
 static void generateLLVM(llvm::Module *module, bool emitAsm, llvm::raw_ostream *out)
 {
     llvm::PassManager passes;
@@ -264,12 +592,14 @@ static void generateLLVM(llvm::Module *module, bool emitAsm, llvm::raw_ostream *
 static void generateAssembly(llvm::Module *module,
                              llvm::TargetMachine *targetMachine,
                              llvm::raw_ostream *out,
-                             bool emitObject)
+                             bool emitObject,
+                             bool verify)
 {
     llvm::FunctionPassManager fpasses(module);
 
     fpasses.add(new llvm::DataLayout(module));
-    fpasses.add(llvm::createVerifierPass());
+    if (verify)
+        fpasses.add(llvm::createVerifierPass());
 
     targetMachine->setAsmVerbosityDefault(true);
 
@@ -290,6 +620,44 @@ static void generateAssembly(llvm::Module *module,
     fpasses.doFinalization();
 }
 
+// the versions of multiversioned external procedures for one feature set,
+// compiled with those features added to the target's
+static bool generateMultiversionObject(MultiversionModule const &version,
+                                       llvm::TargetMachine *targetMachine,
+                                       bool verify,
+                                       PathString &tempObj)
+{
+    string features = targetMachine->getTargetFeatureString().str();
+    if (!features.empty())
+        features += ',';
+    features += version.features;
+
+    llvm::OwningPtr<llvm::TargetMachine> versionMachine(
+        targetMachine->getTarget().createTargetMachine(
+            targetMachine->getTargetTriple(),
+            targetMachine->getTargetCPU(),
+            features,
+            targetMachine->Options,
+            targetMachine->getRelocationModel(),
+            targetMachine->getCodeModel(),
+            targetMachine->getOptLevel()));
+    if (!versionMachine) {
+        llvm::errs() << "error: unable to create target machine for features " << features << '\n';
+        return false;
+    }
+
+    int fd;
+    if (llvm::error_code ec = llvm::sys::fs::unique_file("clayobj-%%%%%%%%.obj", fd, tempObj)) {
+        llvm::errs() << "error creating temporary object file: " << ec.message() << '\n';
+        return false;
+    }
+    llvm::sys::RemoveFileOnSignal(llvm::sys::Path(tempObj));
+
+    llvm::raw_fd_ostream objOut(fd, /*shouldClose=*/ true);
+    generateAssembly(version.module, versionMachine.get(), &objOut, true, verify);
+    return true;
+}
+
 static string joinCmdArgs(llvm::ArrayRef<const char*>  args) {
     string s;
     llvm::raw_string_ostream ss(s);
@@ -315,6 +683,8 @@ static bool generateBinary(llvm::Module *module,
                            bool /*exceptions*/,
                            bool sharedLib,
                            bool debug,
+                           bool verify,
+                           llvm::ArrayRef<MultiversionModule> multiversionModules,
                            llvm::ArrayRef<string> arguments,
                            bool verbose)
 {
@@ -329,7 +699,14 @@ static bool generateBinary(llvm::Module *module,
     {
         llvm::raw_fd_ostream objOut(fd, /*shouldClose=*/ true);
 
-        generateAssembly(module, targetMachine, &objOut, true);
+        generateAssembly(module, targetMachine, &objOut, true, verify);
+    }
+
+    vector<PathString> multiversionObjs(multiversionModules.size());
+    for (size_t i = 0; i < multiversionModules.size(); ++i) {
+        if (!generateMultiversionObject(multiversionModules[i], targetMachine,
+                                        verify, multiversionObjs[i]))
+            return false;
     }
 
     string outputFilePathStr = outputFilePath.str();
@@ -372,6 +749,8 @@ static bool generateBinary(llvm::Module *module,
     clangArgs.push_back("-o");
     clangArgs.push_back(outputFilePathStr.c_str());
     clangArgs.push_back(tempObj.c_str());
+    for (size_t i = 0; i < multiversionObjs.size(); ++i)
+        clangArgs.push_back(multiversionObjs[i].c_str());
     for (unsigned i = 0; i < arguments.size(); ++i)
         clangArgs.push_back(arguments[i].c_str());
     clangArgs.push_back(NULL);
@@ -412,6 +791,8 @@ static bool generateBinary(llvm::Module *module,
 
     bool dontcare;
     llvm::sys::fs::remove(llvm::StringRef(tempObj), dontcare);
+    for (size_t i = 0; i < multiversionObjs.size(); ++i)
+        llvm::sys::fs::remove(llvm::StringRef(multiversionObjs[i]), dontcare);
 
     return (result == 0);
 }
@@ -437,12 +818,22 @@ static void usage(char *argv0)
         << "                        (queryable with Flag?() and Flag())\n";
     llvm::errs() << "  -O0 -O1 -O2 -O3       set optimization level\n";
     llvm::errs() << "                        (default -O2, or -O0 with -g)\n";
+    llvm::errs() << "  -Ofast-compile        like -O0, but skip IR verification, keep\n"
+                 << "                        temporaries in registers and emit only\n"
+                 << "                        line tables with -g\n";
     llvm::errs() << "  -g                    keep debug symbol information\n";
+    llvm::errs() << "  -gline-tables-only    keep only procedure names and line numbers,\n"
+                 << "                        enough for profilers and backtraces\n";
     llvm::errs() << "  -exceptions           enable exception handling\n";
     llvm::errs() << "  -no-exceptions        disable exception handling\n";
+    llvm::errs() << "  -no-nothrow-propagation\n"
+                 << "                        keep exception checks after calls to\n"
+                 << "                        procedures that never throw\n";
     llvm::errs() << "  -inline               inline procedures marked 'forceinline'\n"; 
     llvm::errs() << "                        and enable 'inline' hints (default)\n";
     llvm::errs() << "  -no-inline            ignore 'inline' and 'forceinline' keyword\n";
+    llvm::errs() << "  -inline-report        list each call inlined automatically\n"
+                 << "                        and the estimated size of its callee\n";
     llvm::errs() << "  -import-externals     include externals from imported modules\n"
         << "                        in compilation unit\n"
         << "                        (default when building standalone or -shared)\n";
@@ -450,8 +841,29 @@ static void usage(char *argv0)
         << "                        in compilation unit\n"
         << "                        (default when building -c or -S)\n";
     llvm::errs() << "  -pic                  generate position independent code\n";
+    llvm::errs() << "  -lto <bitcode files>  link bitcode files written by -emit-llvm and\n"
+                 << "                        optimize them as a whole program\n";
     llvm::errs() << "  -run                  execute the program without writing to disk\n";
+    llvm::errs() << "  -no-lazy-compilation  with -run or -e, compile the whole program before\n"
+                 << "                        running it rather than each procedure on its\n"
+                 << "                        first call; always done for programs that\n"
+                 << "                        start threads, as lazy compilation is not\n"
+                 << "                        thread-safe\n";
+    llvm::errs() << "  -run-cache-dir <dir>  with -run or -e, keep the compiled program in\n"
+                 << "                        <dir> and reuse it while its sources are\n"
+                 << "                        unchanged\n";
     llvm::errs() << "  -timing               show timing information\n";
+    llvm::errs() << "  -no-deferred-parsing  parse all procedure bodies of imported modules\n"
+                 << "                        up front instead of on first use, reporting\n"
+                 << "                        syntax errors in unused procedures; without\n"
+                 << "                        it, bodies in any imported module, the\n"
+                 << "                        program's own included, are only checked\n"
+                 << "                        once called\n";
+    llvm::errs() << "  -report-unreachable   list instantiations dropped as unreachable\n";
+    llvm::errs() << "  -merge-functions      fold instantiations with identical bodies\n";
+    llvm::errs() << "  -report-merged-functions\n"
+                 << "                        like -merge-functions, and list the folded\n"
+                 << "                        instantiations of each callable\n";
     llvm::errs() << "  -verbose              be verbose\n";
     llvm::errs() << "  -full-match-errors    show universal patterns in match failure errors\n";
     llvm::errs() << "  -log-match <module.symbol>\n"
@@ -466,12 +878,29 @@ static void usage(char *argv0)
     llvm::errs() << "  -Wl,<opts>            pass flags to linker\n";
     llvm::errs() << "  -l<lib>               link with library <lib>\n";
     llvm::errs() << "  -I<path>              add <path> to clay module search path\n";
+    llvm::errs() << "  -write-module-index <dir>\n"
+                 << "                        list the modules below <dir> in an index file,\n"
+                 << "                        which is used instead of reading its directories\n"
+                 << "                        when <dir> is in the module search path, as long\n"
+                 << "                        as they have not changed since\n";
     llvm::errs() << "  -deps                 keep track of the dependencies of the currently\n";
     llvm::errs() << "                        compiling file and write them to the file\n";
     llvm::errs() << "                        specified by -o-deps\n";
     llvm::errs() << "  -no-deps              don't generate dependencies file\n";
     llvm::errs() << "  -o-deps <file>        write the dependencies to this file\n";
     llvm::errs() << "                        (defaults to <compilation output file>.d)\n";
+    llvm::errs() << "  -deps-graph <file>    write the source files loaded and the procedure\n"
+                 << "                        bodies instantiated from them to <file>\n";
+    llvm::errs() << "  -check-deps <graph> [<changed file>...]\n"
+                 << "                        exit with status 0 if the output recorded in a\n"
+                 << "                        -deps-graph file is unaffected by changes to the\n"
+                 << "                        listed files (or to any file, if none are\n"
+                 << "                        listed), otherwise print why and exit with 1\n";
+    llvm::errs() << "  -profile-generate[=<file>]\n"
+                 << "                        instrument the program to write procedure and\n"
+                 << "                        branch counts to <file> at exit\n"
+                 << "                        (defaults to clay-profile.txt)\n";
+    llvm::errs() << "  -profile-use=<file>   optimize using counts from -profile-generate\n";
     llvm::errs() << "  -e <source>           compile and run <source> (implies -run)\n";
     llvm::errs() << "  -M<module>            \"import <module>.*;\" for -e\n";
     llvm::errs() << "  -version              display version info\n";
@@ -542,13 +971,35 @@ int main2(int argc, char **argv, char const* const* envp) {
     bool verbose = false;
     bool crossCompiling = false;
     bool showTiming = false;
+    bool reportUnreachable = false;
+    bool inlineReport = false;
+    bool noThrowPropagation = true;
+    bool lazyCompilation = true;
+    bool deferredParsing = true;
+    bool mergeFunctions = false;
+    bool reportMergedFunctions = false;
     bool codegenExternals = false;
     bool codegenExternalsSet = false;
 
     bool generateDeps = false;
+    string dependencyGraphFile;
+    string checkDepsFile;
+    string moduleIndexRoot;
+    vector<string> changedFiles;
+
+    string runCacheDir;
+
+    bool lto = false;
+    vector<string> ltoInputFiles;
+
+    bool profileGenerate = false;
+    string profileGenerateFile = "clay-profile.txt";
+    string profileUseFile;
 
     unsigned optLevel = 2;
     bool optLevelSet = false;
+    bool fastCompile = false;
+    bool lineTablesOnly = false;
 
     bool finalOverloadsEnabled = false;
     bool softFloat = false;
@@ -600,24 +1051,40 @@ int main2(int argc, char **argv, char const* const* envp) {
         }
         else if (strcmp(argv[i], "-g") == 0) {
             debug = true;
+            lineTablesOnly = false;
+            if (!optLevelSet)
+                optLevel = 0;
+        }
+        else if (strcmp(argv[i], "-gline-tables-only") == 0) {
+            debug = true;
+            lineTablesOnly = true;
             if (!optLevelSet)
                 optLevel = 0;
         }
         else if (strcmp(argv[i], "-O0") == 0) {
             optLevel = 0;
             optLevelSet = true;
+            fastCompile = false;
+        }
+        else if (strcmp(argv[i], "-Ofast-compile") == 0) {
+            optLevel = 0;
+            optLevelSet = true;
+            fastCompile = true;
         }
         else if (strcmp(argv[i], "-O1") == 0) {
             optLevel = 1;
             optLevelSet = true;
+            fastCompile = false;
         }
         else if (strcmp(argv[i], "-O2") == 0) {
             optLevel = 2;
             optLevelSet = true;
+            fastCompile = false;
         }
         else if (strcmp(argv[i], "-O3") == 0) {
             optLevel = 3;
             optLevelSet = true;
+            fastCompile = false;
         }
         else if (strcmp(argv[i], "-inline") == 0) {
             inlineEnabled = true;
@@ -625,6 +1092,9 @@ int main2(int argc, char **argv, char const* const* envp) {
         else if (strcmp(argv[i], "-no-inline") == 0) {
             inlineEnabled = false;
         }
+        else if (strcmp(argv[i], "-inline-report") == 0) {
+            inlineReport = true;
+        }
         else if (strcmp(argv[i], "-exceptions") == 0) {
             exceptions = true;
         }
@@ -633,6 +1103,12 @@ int main2(int argc, char **argv, char const* const* envp) {
 
             exceptions = false;
         }
+        else if (strcmp(argv[i], "-no-nothrow-propagation") == 0) {
+            noThrowPropagation = false;
+        }
+        else if (strcmp(argv[i], "-no-lazy-compilation") == 0) {
+            lazyCompilation = false;
+        }
         else if (strcmp(argv[i], "-pic") == 0) {
             genPIC = true;
         }
@@ -642,12 +1118,33 @@ int main2(int argc, char **argv, char const* const* envp) {
         else if (strcmp(argv[i], "-run") == 0) {
             run = true;
         }
+        else if (strcmp(argv[i], "-run-cache-dir") == 0) {
+            ++i;
+            if (i == argc) {
+                llvm::errs() << "error: directory missing after -run-cache-dir\n";
+                return 1;
+            }
+            runCacheDir = argv[i];
+        }
         else if (strcmp(argv[i], "-repl") == 0) {
             repl = true;
         }
         else if (strcmp(argv[i], "-timing") == 0) {
             showTiming = true;
         }
+        else if (strcmp(argv[i], "-no-deferred-parsing") == 0) {
+            deferredParsing = false;
+        }
+        else if (strcmp(argv[i], "-report-unreachable") == 0) {
+            reportUnreachable = true;
+        }
+        else if (strcmp(argv[i], "-merge-functions") == 0) {
+            mergeFunctions = true;
+        }
+        else if (strcmp(argv[i], "-report-merged-functions") == 0) {
+            mergeFunctions = true;
+            reportMergedFunctions = true;
+        }
         else if (strcmp(argv[i], "-full-match-errors") == 0) {
             shouldPrintFullMatchErrors = true;
         }
@@ -911,6 +1408,48 @@ int main2(int argc, char **argv, char const* const* envp) {
             }
             dependenciesOutputFile = argv[i];
         }
+        else if (strcmp(argv[i], "-deps-graph") == 0) {
+            ++i;
+            if (i == argc) {
+                llvm::errs() << "error: filename missing after -deps-graph\n";
+                return 1;
+            }
+            dependencyGraphFile = argv[i];
+        }
+        else if (strcmp(argv[i], "-write-module-index") == 0) {
+            ++i;
+            if (i == argc) {
+                llvm::errs() << "error: directory missing after -write-module-index\n";
+                return 1;
+            }
+            moduleIndexRoot = argv[i];
+        }
+        else if (strcmp(argv[i], "-check-deps") == 0) {
+            ++i;
+            if (i == argc) {
+                llvm::errs() << "error: filename missing after -check-deps\n";
+                return 1;
+            }
+            checkDepsFile = argv[i];
+        }
+        else if (strcmp(argv[i], "-profile-generate") == 0) {
+            profileGenerate = true;
+        }
+        else if (strncmp(argv[i], "-profile-generate=", 18) == 0) {
+            profileGenerate = true;
+            profileGenerateFile = argv[i] + 18;
+            if (profileGenerateFile.empty()) {
+                llvm::errs() << "error: filename missing after -profile-generate=\n";
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "-profile-use=", 13) == 0) {
+            profileUseFile = argv[i] + 13;
+            if (profileUseFile.empty()) {
+                llvm::errs() << "error: filename missing after -profile-use=\n";
+                return 1;
+            }
+        }
         else if (strcmp(argv[i], "--") == 0) {
             ++i;
             if (clayFile.empty()) {
@@ -934,7 +1473,22 @@ int main2(int argc, char **argv, char const* const* envp) {
             usage(argv[0]);
             return 2;
         }       
+        else if (strcmp(argv[i], "-lto") == 0) {
+            lto = true;
+            if (!clayFile.empty()) {
+                ltoInputFiles.push_back(clayFile);
+                clayFile.clear();
+            }
+        }
         else if (strstr(argv[i], "-") != argv[i]) {
+            if (!checkDepsFile.empty()) {
+                changedFiles.push_back(argv[i]);
+                continue;
+            }
+            if (lto) {
+                ltoInputFiles.push_back(argv[i]);
+                continue;
+            }
             if (!clayFile.empty()) {
                 llvm::errs() << "error: clay file already specified: " << clayFile
                      << ", unrecognized parameter: " << argv[i] << '\n';
@@ -955,7 +1509,37 @@ int main2(int argc, char **argv, char const* const* envp) {
         printVersion();
     }
 
-    if (repl && clayScript.empty() && clayFile.empty()) {
+    if (!moduleIndexRoot.empty()) {
+        string errorMessage;
+        if (!writeModuleIndex(moduleIndexRoot, errorMessage)) {
+            llvm::errs() << "error: " << errorMessage << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!checkDepsFile.empty()) {
+        string reason;
+        if (dependenciesChanged(checkDepsFile, changedFiles, reason)) {
+            llvm::outs() << reason << '\n';
+            return 1;
+        }
+        if (verbose)
+            llvm::errs() << "no rebuild needed\n";
+        return 0;
+    }
+
+    if (lto) {
+        if (ltoInputFiles.empty()) {
+            llvm::errs() << "error: no bitcode files specified for -lto\n";
+            return 1;
+        }
+        if (!clayScript.empty() || repl || generateDeps || !dependencyGraphFile.empty()) {
+            llvm::errs() << "error: '-lto' can not be used together with '-e', '-repl', '-deps' or '-deps-graph'\n";
+            return 1;
+        }
+    }
+    else if (repl && clayScript.empty() && clayFile.empty()) {
         clayScript = "/*empty module if file not specified*/";
     }
     else {
@@ -978,6 +1562,11 @@ int main2(int argc, char **argv, char const* const* envp) {
         return 1;
     }
 
+    if (!dependencyGraphFile.empty() && (run || repl)) {
+        llvm::errs() << "error: '-deps-graph' can not be used together with '-e', '-run' or '-repl'\n";
+        return 1;
+    }
+
     if (crossCompiling && run) {
         llvm::errs() << "error: cannot use -run when cross compiling\n";
         return 1;
@@ -998,8 +1587,33 @@ int main2(int argc, char **argv, char const* const* envp) {
     if ((emitLLVM || emitAsm || emitObject) && run)
         run = false;
 
+    // checked after -emit-llvm, -S and -c have turned -run off
+    if (!runCacheDir.empty() && (!run || repl || generateDeps)) {
+        llvm::errs() << "error: '-run-cache-dir' requires '-run' or '-e', and can not be used together with '-repl' or '-deps'\n";
+        return 1;
+    }
+
+    if (profileGenerate && (run || repl)) {
+        llvm::errs() << "error: '-profile-generate' can not be used together with '-e', '-run' or '-repl'\n";
+        return 1;
+    }
+    if (profileGenerate)
+        setProfileGenerate(profileGenerateFile);
+    if (!profileUseFile.empty()) {
+        string errorMessage;
+        if (!loadProfile(profileUseFile, errorMessage)) {
+            llvm::errs() << "error: unable to read profile " << profileUseFile
+                         << ": " << errorMessage << "\n";
+            return 1;
+        }
+    }
+
     setInlineEnabled(inlineEnabled);
     setExceptionsEnabled(exceptions);
+    setReportUnreachable(reportUnreachable);
+    setDebugLineTablesOnly(lineTablesOnly || fastCompile);
+    setInlineReport(inlineReport);
+    setNoThrowPropagation(noThrowPropagation);
     
     setFinalOverloadsEnabled(finalOverloadsEnabled);
     
@@ -1070,7 +1684,8 @@ int main2(int argc, char **argv, char const* const* envp) {
 
 
     if (outputFile.empty()) {
-        llvm::StringRef clayFileBasename = llvm::sys::path::stem(clayFile);
+        llvm::StringRef clayFileBasename =
+            llvm::sys::path::stem(lto ? ltoInputFiles[0] : clayFile);
         outputFile = string(clayFileBasename.begin(), clayFileBasename.end());
 
         if (emitLLVM && emitAsm)
@@ -1115,27 +1730,49 @@ int main2(int argc, char **argv, char const* const* envp) {
 
     HiResTimer loadTimer, compileTimer, optTimer, outputTimer;
 
+    string runCacheKeyStr;
+    if (!runCacheDir.empty()) {
+        runCacheKeyStr = runCacheKey(argc, argv, targetTriple, searchPath);
+        llvm::Module *cachedModule = loadRunCache(runCacheDir, runCacheKeyStr, verbose);
+        if (cachedModule != NULL) {
+            llvmModule = cachedModule;
+            vector<string> argv;
+            argv.push_back(clayFile);
+            runModule(llvmModule, argv, envp, libSearchPath, libraries,
+                      lazyCompilation);
+            _exit(0);
+        }
+    }
+
 
 	//compiler
 
     loadTimer.start();
     try {
         initLoader();
+        setDeferredParsing(deferredParsing);
 
         ModulePtr m;
         string clayScriptSource;
         vector<string> sourceFiles;
-        if (!clayScript.empty()) {
+        if (lto) {
+            if (!linkModulesForLTO(llvmModule, ltoInputFiles, verbose))
+                return 1;
+            if (!(sharedLib || emitLLVM || emitAsm || emitObject))
+                internalizeForLTO(llvmModule);
+        } else if (!clayScript.empty()) {
             clayScriptSource = clayScriptImports + "main() {\n" + clayScript + "}";
-            m = loadProgramSource("-e", clayScriptSource, verbose, repl);
-        } else if (generateDeps)
+            m = loadProgramSource("-e", clayScriptSource,
+                runCacheDir.empty() ? NULL : &sourceFiles, verbose, repl);
+        } else if (generateDeps || !dependencyGraphFile.empty() || !runCacheDir.empty())
             m = loadProgram(clayFile, &sourceFiles, verbose, repl);
         else
             m = loadProgram(clayFile, NULL, verbose, repl);
 
         loadTimer.stop();
         compileTimer.start();
-        codegenEntryPoints(m, codegenExternals);
+        if (!lto)
+            codegenEntryPoints(m, codegenExternals);
         compileTimer.stop();
 
         if (generateDeps) {
@@ -1160,23 +1797,55 @@ int main2(int argc, char **argv, char const* const* envp) {
             }
         }
 
+        if (!dependencyGraphFile.empty()) {
+            string errorMessage;
+            if (verbose) {
+                llvm::errs() << "generating dependency graph into " << dependencyGraphFile << "\n";
+            }
+            if (!writeDependencyGraph(dependencyGraphFile, outputFile, sourceFiles, errorMessage)) {
+                llvm::errs() << "error: " << errorMessage << '\n';
+                return 1;
+            }
+        }
+
         bool internalize = true;
         if (debug || sharedLib || run || !codegenExternals)
             internalize = false;
 
         optTimer.start();
 
+        // only binaries get the versions of multiversioned procedures,
+        // since clay links in the objects they are compiled to
+        vector<MultiversionModule> multiversionModules;
+        if (run || repl || emitLLVM || emitAsm || emitObject)
+            dropMultiversionedProcedures(llvmModule);
+        else
+            splitMultiversionedProcedures(llvmModule, multiversionModules);
+
         if (!repl)
         {
+            if (mergeFunctions)
+                mergeIdenticalFunctions(llvmModule, reportMergedFunctions);
             if (optLevel > 0)
                 optimizeLLVM(llvmModule, optLevel, internalize);
+            else if (fastCompile)
+                promoteTemporaries(llvmModule);
+            for (size_t i = 0; i < multiversionModules.size(); ++i) {
+                if (optLevel > 0)
+                    optimizeLLVM(multiversionModules[i].module, optLevel, false);
+                else if (fastCompile)
+                    promoteTemporaries(multiversionModules[i].module);
+            }
         }
         optTimer.stop();
 
         if (run) {
+            if (!runCacheDir.empty())
+                writeRunCache(runCacheDir, runCacheKeyStr, llvmModule, sourceFiles, verbose);
             vector<string> argv;
             argv.push_back(clayFile);
-            runModule(llvmModule, argv, envp, libSearchPath, libraries);
+            runModule(llvmModule, argv, envp, libSearchPath, libraries,
+                      lazyCompilation);
         }
         else if (repl) {
             linkLibraries(llvmModule, libSearchPath, libraries);
@@ -1192,10 +1861,13 @@ int main2(int argc, char **argv, char const* const* envp) {
                 return 1;
             }
             outputTimer.start();
+            if (emitLLVM && !emitAsm)
+                markModuleForLTO(llvmModule);
             if (emitLLVM)
                 generateLLVM(llvmModule, emitAsm, &out);
             else if (emitAsm || emitObject)
-                generateAssembly(llvmModule, targetMachine, &out, emitObject);
+                generateAssembly(llvmModule, targetMachine, &out, emitObject,
+                                 !fastCompile);
             outputTimer.stop();
         }
         else {
@@ -1232,7 +1904,8 @@ int main2(int argc, char **argv, char const* const* envp) {
 
             outputTimer.start();
             result = generateBinary(llvmModule, targetMachine, outputFile, clangPath,
-                                    exceptions, sharedLib, debug, arguments, verbose);
+                                    exceptions, sharedLib, debug, !fastCompile,
+                                    multiversionModules, arguments, verbose);
             outputTimer.stop();
             if (!result)
                 return 1;
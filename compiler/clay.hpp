@@ -8,6 +8,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <exception>
 #include <map>
 #include <set>
@@ -26,9 +27,12 @@
 #pragma warning(disable: 4146 4244 4267 4355 4146 4800 4996)
 #endif
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/FoldingSet.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Triple.h>
@@ -57,6 +61,7 @@
 #include <llvm/Module.h>
 #include <llvm/PassManager.h>
 #include <llvm/Support/Allocator.h>
+#include <llvm/Support/CFG.h>
 #include <llvm/Support/Dwarf.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/FormattedStream.h>
@@ -73,6 +78,7 @@
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Utils/Local.h>
 #include <llvm/Transforms/Vectorize.h>
 #include <llvm/Type.h>
 
@@ -619,9 +625,12 @@ struct Location {
 // error module
 //
 
+// params and dispatchIndices are stored inline for the common case of a
+// short argument list, since an entry is pushed for every call analyzed,
+// evaluated or generated.
 struct CompileContextEntry {
-    vector<ObjectPtr> params;
-    vector<unsigned> dispatchIndices;
+    llvm::SmallVector<ObjectPtr, 4> params;
+    llvm::SmallVector<unsigned, 2> dispatchIndices;
 
     Location location;
 
@@ -633,12 +642,14 @@ struct CompileContextEntry {
         : callable(callable), hasParams(false) {}
 
     CompileContextEntry(ObjectPtr callable, llvm::ArrayRef<ObjectPtr> params)
-        : params(params), callable(callable), hasParams(true) {}
+        : params(params.begin(), params.end()), callable(callable), hasParams(true) {}
 
     CompileContextEntry(ObjectPtr callable,
                         llvm::ArrayRef<ObjectPtr> params,
                         llvm::ArrayRef<unsigned> dispatchIndices)
-        : params(params), dispatchIndices(dispatchIndices), callable(callable), hasParams(true) {}
+        : params(params.begin(), params.end()),
+          dispatchIndices(dispatchIndices.begin(), dispatchIndices.end()),
+          callable(callable), hasParams(true) {}
 };
 
 void pushCompileContext(ObjectPtr obj);
@@ -736,16 +747,13 @@ struct Identifier : public ANode {
     Identifier(llvm::StringRef str, bool isOperator)
         : ANode(IDENTIFIER), str(str), isOperator(isOperator) {}
 
-    static map<llvm::StringRef, IdentifierPtr> freeIdentifiers; // in parser.cpp
+    static llvm::StringMap<IdentifierPtr> freeIdentifiers; // in parser.cpp
     
     static Identifier *get(llvm::StringRef str, bool isOperator = false) {
-        map<llvm::StringRef, IdentifierPtr>::const_iterator iter = freeIdentifiers.find(str);
-        if (iter == freeIdentifiers.end()) {
-            Identifier *ident = new Identifier(str, isOperator);
-            freeIdentifiers[ident->str] = ident;
-            return ident;
-        } else
-            return iter->second.ptr();
+        IdentifierPtr &ident = freeIdentifiers[str];
+        if (!ident)
+            ident = new Identifier(str, isOperator);
+        return ident.ptr();
     }
     
     static Identifier *get(llvm::StringRef str, Location const &location, bool isOperator = false) {
@@ -1549,11 +1557,16 @@ struct Code : public ANode {
     ReturnSpecPtr varReturnSpec;
     StatementPtr body;
     LLVMCodePtr llvmBody;
+    // `{ ... }` bodies of library procedures are left unparsed until
+    // the procedure is first instantiated (see parseDeferredBody)
+    Location deferredBody;
+    unsigned deferredBodyLength;
     bool hasVarArg:1;
     bool returnSpecsDeclared:1;
 
     Code()
-        : ANode(CODE),  hasVarArg(false), returnSpecsDeclared(false) {}
+        : ANode(CODE), deferredBodyLength(0),
+          hasVarArg(false), returnSpecsDeclared(false) {}
     Code(llvm::ArrayRef<PatternVar> patternVars,
          ExprPtr predicate,
          llvm::ArrayRef<FormalArgPtr> formalArgs,
@@ -1563,7 +1576,7 @@ struct Code : public ANode {
         : ANode(CODE), patternVars(patternVars), predicate(predicate),
           formalArgs(formalArgs),
           returnSpecs(returnSpecs), varReturnSpec(varReturnSpec),
-          body(body),
+          body(body), deferredBodyLength(0),
           hasVarArg(false), returnSpecsDeclared(false)
           {}
 
@@ -1581,7 +1594,7 @@ struct Code : public ANode {
         return llvmBody.ptr() != NULL;
     }
     bool hasBody() {
-        return body.ptr() || isLLVMBody();
+        return body.ptr() || deferredBody.ok() || isLLVMBody();
     }
 };
 
@@ -1910,6 +1923,9 @@ struct ExternalProcedure : public TopLevelItem {
     ExprListPtr attributes;
 
     llvm::SmallString<16> attrAsmLabel;
+    // -mattr style feature sets of the versions of a `multiversion`
+    // procedure, in increasing order of preference
+    vector<string> attrMultiversionFeatures;
 
     TypePtr returnType2;
     TypePtr ptrType;
@@ -1922,6 +1938,7 @@ struct ExternalProcedure : public TopLevelItem {
     bool attributesVerified:1;
     bool attrDLLImport:1;
     bool attrDLLExport:1;
+    bool attrMultiversion:1;
     bool analyzed:1;
     bool bodyCodegenned:1;
 
@@ -1,6 +1,7 @@
 #include "clone.hpp"
 #include "clay.hpp"
 #include "analyzer.hpp"
+#include "parser.hpp"
 
 
 #pragma clang diagnostic ignored "-Wcovered-switch-default"
@@ -10,6 +11,7 @@ namespace clay {
 
 CodePtr clone(CodePtr x)
 {
+    parseDeferredBody(x);
     CodePtr y = new Code();
     y->location = x->location;
     clone(x->patternVars, y->patternVars);
@@ -40,29 +42,49 @@ void clone(llvm::ArrayRef<IdentifierPtr> x, vector<IdentifierPtr> &out)
         out.push_back(x[i]);
 }
 
-ExprPtr clone(ExprPtr x)
+// an expression is shared between all clones of a code body rather than
+// copied when it has no mutable state besides cachedAnalysis, and that
+// analysis only depends on the module the expression was written in,
+// which is the same for every clone
+static bool isSharedExpr(ExprPtr x)
 {
-    ExprPtr out;
-
     switch (x->exprKind) {
-
-    case BOOL_LITERAL : {
-        BoolLiteral *y = (BoolLiteral *)x.ptr();
-        out = new BoolLiteral(y->value);
-        break;
+    case BOOL_LITERAL :
+    case INT_LITERAL :
+    case FLOAT_LITERAL :
+    case STRING_LITERAL :
+    case LINE_EXPR :
+    case COLUMN_EXPR :
+    case OBJECT_EXPR :
+        return true;
+    default :
+        return false;
     }
+}
 
-    case INT_LITERAL : {
-        IntLiteral *y = (IntLiteral *)x.ptr();
-        out = new IntLiteral(y->value, y->suffix);
-        break;
+// likewise for statements without any analysis or desugaring state
+static bool isSharedStatement(StatementPtr x)
+{
+    switch (x->stmtKind) {
+    case LABEL :
+    case GOTO :
+    case BREAK :
+    case CONTINUE :
+    case UNREACHABLE :
+        return true;
+    default :
+        return false;
     }
+}
 
-    case FLOAT_LITERAL : {
-        FloatLiteral *y = (FloatLiteral *)x.ptr();
-        out = new FloatLiteral(y->value, y->suffix);
-        break;
-    }
+ExprPtr clone(ExprPtr x)
+{
+    if (isSharedExpr(x))
+        return x;
+
+    ExprPtr out;
+
+    switch (x->exprKind) {
 
     case CHAR_LITERAL : {
         CharLiteral *y = (CharLiteral *)x.ptr();
@@ -70,27 +92,11 @@ ExprPtr clone(ExprPtr x)
         break;
     }
 
-    case STRING_LITERAL : {
-        StringLiteral *y = (StringLiteral *)x.ptr();
-        out = new StringLiteral(y->value);
-        break;
-    }
-
     case FILE_EXPR : {
         out = new FILEExpr();
         break;
     }
 
-    case LINE_EXPR : {
-        out = new LINEExpr();
-        break;
-    }
-
-    case COLUMN_EXPR : {
-        out = new COLUMNExpr();
-        break;
-    }
-
     case ARG_EXPR : {
         ARGExpr *arg = (ARGExpr *)x.ptr();
         out = new ARGExpr(arg->name);
@@ -187,12 +193,6 @@ ExprPtr clone(ExprPtr x)
         break;
     }
 
-    case OBJECT_EXPR : {
-        ObjectExpr *y = (ObjectExpr *)x.ptr();
-        out = new ObjectExpr(y->obj);
-        break;
-    }
-
     case EVAL_EXPR : {
         EvalExpr *eval = (EvalExpr*)x.ptr();
         out = new EvalExpr(clone(eval->args));
@@ -272,6 +272,9 @@ ReturnSpecPtr cloneOpt(ReturnSpecPtr x)
 
 StatementPtr clone(StatementPtr x)
 {
+    if (isSharedStatement(x))
+        return x;
+
     StatementPtr out;
 
     switch (x->stmtKind) {
@@ -284,12 +287,6 @@ StatementPtr clone(StatementPtr x)
         break;
     }
 
-    case LABEL : {
-        Label *y = (Label *)x.ptr();
-        out = new Label(y->name);
-        break;
-    }
-
     case BINDING : {
         Binding *y = (Binding *)x.ptr();
         vector<FormalArgPtr> args;
@@ -321,12 +318,6 @@ StatementPtr clone(StatementPtr x)
         break;
     }
 
-    case GOTO : {
-        Goto *y = (Goto *)x.ptr();
-        out = new Goto(y->labelName);
-        break;
-    }
-
     case RETURN : {
         Return *y = (Return *)x.ptr();
         out = new Return(y->returnKind, clone(y->values));
@@ -369,16 +360,6 @@ StatementPtr clone(StatementPtr x)
         break;
     }
 
-    case BREAK : {
-        out = new Break();
-        break;
-    }
-
-    case CONTINUE : {
-        out = new Continue();
-        break;
-    }
-
     case FOR : {
         For *y = (For *)x.ptr();
         vector<IdentifierPtr> variables;
@@ -429,11 +410,6 @@ StatementPtr clone(StatementPtr x)
         break;
     }
 
-    case UNREACHABLE : {
-        out = new Unreachable();
-        break;
-    }
-
     case EVAL_STATEMENT : {
         EvalStatement *eval = (EvalStatement *)x.ptr();
         out = new EvalStatement(eval->args);
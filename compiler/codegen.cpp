@@ -16,6 +16,8 @@
 #include "error.hpp"
 #include "int128.hpp"
 #include "codegen_op.hpp"
+#include "pgo.hpp"
+#include "multiversion.hpp"
 
 #include "codegen.hpp"
 
@@ -34,6 +36,42 @@ static vector<CValuePtr> initializedGlobals;
 static CodegenContext *constructorsCtx = NULL;
 static CodegenContext *destructorsCtx = NULL;
 
+// while a global variable initializer is being generated, bodies are
+// generated immediately so that globals used by the callees are initialized
+// ahead of the global that calls them
+static int eagerCodeBodies = 0;
+
+static void discardPendingCodeBodies();
+
+namespace {
+    // a CompilerError that escapes the scope abandons the input being
+    // compiled (in the repl), along with the bodies it queued
+    class EagerCodeBodiesScope {
+    private:
+        bool finished;
+    public:
+        EagerCodeBodiesScope() : finished(false) { ++eagerCodeBodies; }
+        void finish() { finished = true; }
+        ~EagerCodeBodiesScope() {
+            --eagerCodeBodies;
+            if (!finished)
+                discardPendingCodeBodies();
+        }
+    };
+}
+
+static bool _debugLineTablesOnly = false;
+
+bool fullDebugInfo()
+{
+    return llvmDIBuilder != NULL && !_debugLineTablesOnly;
+}
+
+void setDebugLineTablesOnly(bool enabled)
+{
+    _debugLineTablesOnly = enabled;
+}
+
 static bool isMsvcTarget() {
     llvm::Triple target(llvmModule->getTargetTriple());
     return (target.getOS() == llvm::Triple::Win32);
@@ -61,6 +99,10 @@ llvm::Value *codegenToBoolFlag(CValuePtr a, CodegenContext* ctx);
 
 size_t cgMarkStack(CodegenContext* ctx);
 void cgDestroyStack(size_t marker, CodegenContext* ctx, bool exception);
+void cgDestroyStackAndBranch(size_t marker,
+                             llvm::BasicBlock *target,
+                             CodegenContext* ctx,
+                             bool exception);
 void cgPopStack(size_t marker, CodegenContext* ctx);
 void cgDestroyAndPopStack(size_t marker, CodegenContext* ctx, bool exception);
 void cgPushStackValue(CValuePtr cv, CodegenContext* ctx);
@@ -254,6 +296,27 @@ void setExceptionsEnabled(bool enabled)
     _exceptionsEnabled = enabled;
 }
 
+static bool _noThrowPropagation = true;
+
+void setNoThrowPropagation(bool enabled)
+{
+    _noThrowPropagation = enabled;
+}
+
+static bool _reportUnreachable = false;
+
+void setReportUnreachable(bool enabled)
+{
+    _reportUnreachable = enabled;
+}
+
+static bool _inlineReport = false;
+
+void setInlineReport(bool enabled)
+{
+    _inlineReport = enabled;
+}
+
 
 
 //
@@ -489,6 +552,66 @@ void cgDestroyStack(size_t marker, CodegenContext* ctx, bool exception)
     }
 }
 
+//
+// exits that leave several scopes (exception checks, return, break,
+// continue, goto) share their cleanup code: each value stack entry keeps the
+// blocks that destroy it on the way to a given target, chained to the
+// block for the entry below, so an exit only needs to branch into the chain
+// at its own depth.
+//
+
+static llvm::BasicBlock *cgCleanupBlock(size_t index,
+                                        size_t marker,
+                                        llvm::BasicBlock *target,
+                                        CodegenContext* ctx,
+                                        bool exception)
+{
+    vector<CleanupBlock> &cleanups = ctx->valueStack[index].cleanups;
+    for (size_t i = 0; i < cleanups.size(); ++i) {
+        CleanupBlock const &cleanup = cleanups[i];
+        if (cleanup.target == target && cleanup.marker == marker
+            && cleanup.exception == exception)
+            return cleanup.block;
+    }
+
+    llvm::BasicBlock *next = (index == marker)
+        ? target
+        : cgCleanupBlock(index - 1, marker, target, ctx, exception);
+
+    llvm::BasicBlock *savedBlock = ctx->builder->GetInsertBlock();
+    llvm::BasicBlock *block = newBasicBlock("cleanup", ctx);
+    ctx->builder->SetInsertPoint(block);
+    // destroying the entry may grow the value stack; work on a copy
+    ValueStackEntry entry = ctx->valueStack[index];
+    codegenStackEntryDestroy(entry, ctx, exception);
+    if (ctx->builder->GetInsertBlock() == block && block->empty()) {
+        // nothing to destroy; let exits skip straight to the next block
+        block->eraseFromParent();
+        block = next;
+    } else {
+        ctx->builder->CreateBr(next);
+    }
+    ctx->builder->SetInsertPoint(savedBlock);
+
+    ctx->valueStack[index].cleanups.push_back(
+        CleanupBlock(target, marker, exception, block));
+    return block;
+}
+
+void cgDestroyStackAndBranch(size_t marker,
+                             llvm::BasicBlock *target,
+                             CodegenContext* ctx,
+                             bool exception)
+{
+    assert(marker <= ctx->valueStack.size());
+    if (marker == ctx->valueStack.size()) {
+        ctx->builder->CreateBr(target);
+        return;
+    }
+    size_t top = ctx->valueStack.size() - 1;
+    ctx->builder->CreateBr(cgCleanupBlock(top, marker, target, ctx, exception));
+}
+
 void cgPopStack(size_t marker, CodegenContext* ctx)
 {
     assert(marker <= ctx->valueStack.size());
@@ -1435,7 +1558,7 @@ void codegenGVarInstance(GVarInstancePtr x)
         *llvmModule, llvmType(y.type), false,
         llvm::GlobalVariable::InternalLinkage,
         initializer, symbolStr.str());
-    if (llvmDIBuilder != NULL) {
+    if (fullDebugInfo()) {
         unsigned line, column;
         llvm::DIFile file = getDebugLineCol(x->gvar->location, line, column);
         x->debugInfo = (llvm::MDNode*)llvmDIBuilder->createGlobalVariable(
@@ -1462,8 +1585,11 @@ void codegenGVarInstance(GVarInstancePtr x)
     lhs->location = x->gvar->name->location;
     StatementPtr init = new InitAssignment(lhs, x->expr);
     init->location = x->gvar->location;
+    EagerCodeBodiesScope eager;
+    codegenPendingCodeBodies();
     bool result = codegenStatement(init, x->env, constructorsCtx);
     assert(!result);
+    eager.finish();
 
     // generate destructor procedure body
     codegenCallable(operator_destroy(),
@@ -1495,7 +1621,7 @@ void codegenExternalVariable(ExternalVariablePtr x)
         new llvm::GlobalVariable(
             *llvmModule, llvmType(pv.type), false,
             linkage, NULL, x->name->str.str());
-    if (llvmDIBuilder != NULL) {
+    if (fullDebugInfo()) {
         unsigned line, column;
         llvm::DIFile file = getDebugLineCol(x->location, line, column);
         x->debugInfo = (llvm::MDNode*)llvmDIBuilder->createGlobalVariable(
@@ -1511,6 +1637,116 @@ void codegenExternalVariable(ExternalVariablePtr x)
 }
 
 
+//
+// codegenMultiversionDispatch
+//
+// makes x->llvmFunc a dispatcher to the version chosen by
+// clayglobals_init, and returns the function for the baseline body
+//
+
+static llvm::Value *codegenCPUHasFeatures(ExternalProcedurePtr x,
+                                          llvm::StringRef featureSet,
+                                          CodegenContext *ctx)
+{
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    featureSet.split(names, ",", -1, false);
+    llvm::Value *supported = llvm::ConstantInt::getTrue(llvm::getGlobalContext());
+    for (size_t i = 0; i < names.size(); ++i) {
+        llvm::StringRef name = names[i].trim();
+        if (name.startswith("+"))
+            name = name.substr(1);
+        ExprListPtr args = new ExprList(new ObjectExpr(Identifier::get(name)));
+        ExprPtr check = new Call(operator_expr_cpuHasFeatureP(), args);
+        check->location = x->location;
+
+        size_t tempMarker = markTemps(ctx);
+        size_t marker = cgMarkStack(ctx);
+        CValuePtr cv = codegenOneAsRef(check, x->env, ctx);
+        llvm::Value *flag = codegenToBoolFlag(cv, ctx);
+        cgDestroyAndPopStack(marker, ctx, false);
+        clearTemps(tempMarker, ctx);
+
+        supported = ctx->builder->CreateAnd(supported, flag);
+    }
+    return supported;
+}
+
+static string multiversionSuffix(llvm::StringRef featureSet)
+{
+    string suffix;
+    for (size_t i = 0; i < featureSet.size(); ++i) {
+        char c = featureSet[i];
+        if (isalnum((unsigned char)c))
+            suffix.push_back(c);
+        else if (c != ' ' && c != '+')
+            suffix.push_back('_');
+    }
+    return suffix;
+}
+
+static llvm::Function *codegenMultiversionDispatch(ExternalProcedurePtr x)
+{
+    if (constructorsCtx == NULL)
+        error(x, "multiversion external procedures can only be "
+              "generated as part of a program");
+
+    llvm::Function *dispatcher = x->llvmFunc;
+    llvm::FunctionType *funcType = dispatcher->getFunctionType();
+    string name = dispatcher->getName().str();
+
+    llvm::Function *baseline = llvm::Function::Create(
+        funcType, llvm::Function::InternalLinkage, name + ".baseline", llvmModule);
+    baseline->setCallingConv(dispatcher->getCallingConv());
+    baseline->setAttributes(dispatcher->getAttributes());
+
+    llvm::GlobalVariable *resolved = new llvm::GlobalVariable(
+        *llvmModule, llvm::PointerType::getUnqual(funcType), false,
+        llvm::GlobalVariable::InternalLinkage, baseline, name + ".resolved");
+
+    llvm::BasicBlock *entryBlock = llvm::BasicBlock::Create(
+        llvm::getGlobalContext(), "entry", dispatcher);
+    llvm::IRBuilder<> builder(entryBlock);
+    vector<llvm::Value*> args;
+    llvm::Function::arg_iterator ai, aend;
+    for (ai = dispatcher->arg_begin(), aend = dispatcher->arg_end(); ai != aend; ++ai)
+        args.push_back(ai);
+    llvm::CallInst *call = builder.CreateCall(builder.CreateLoad(resolved),
+                                              llvm::makeArrayRef(args));
+    call->setCallingConv(dispatcher->getCallingConv());
+    call->setAttributes(dispatcher->getAttributes());
+    call->setTailCall();
+    if (funcType->getReturnType()->isVoidTy())
+        builder.CreateRetVoid();
+    else
+        builder.CreateRet(call);
+
+    // later versions are preferred, so the last supported one is chosen
+    MultiversionedProcedure procedure;
+    procedure.baseline = baseline->getName().str();
+    llvm::Value *chosen = baseline;
+    for (size_t i = 0; i < x->attrMultiversionFeatures.size(); ++i) {
+        llvm::StringRef featureSet = x->attrMultiversionFeatures[i];
+        llvm::Function *version = llvm::Function::Create(
+            funcType, llvm::Function::ExternalLinkage,
+            name + "." + multiversionSuffix(featureSet), llvmModule);
+        version->setCallingConv(dispatcher->getCallingConv());
+        version->setAttributes(dispatcher->getAttributes());
+
+        MultiversionClone clone;
+        clone.features = multiversionTargetFeatures(featureSet);
+        clone.name = version->getName().str();
+        procedure.clones.push_back(clone);
+
+        llvm::Value *supported = codegenCPUHasFeatures(x, featureSet, constructorsCtx);
+        chosen = constructorsCtx->builder->CreateSelect(supported, version, chosen);
+    }
+    constructorsCtx->builder->CreateStore(chosen, resolved);
+    multiversionedProcedures.push_back(procedure);
+
+    return baseline;
+}
+
+
 //
 // codegenExternalProcedure
 //
@@ -1585,11 +1821,11 @@ void codegenExternalProcedure(ExternalProcedurePtr x, bool codegenBody)
             file = getDebugLineCol(x->location, line, column);
 
             vector<llvm::Value*> debugParamTypes;
-            if (x->returnType2 == NULL)
+            if (x->returnType2 == NULL || !fullDebugInfo())
                 debugParamTypes.push_back(llvmVoidTypeDebugInfo());
             else
                 debugParamTypes.push_back(llvmTypeDebugInfo(x->returnType2));
-            for (size_t i = 0; i < x->args.size(); ++i)
+            for (size_t i = 0; fullDebugInfo() && i < x->args.size(); ++i)
                 debugParamTypes.push_back(llvmTypeDebugInfo(x->args[i]->type2));
 
             llvm::DIArray debugParamArray = llvmDIBuilder->getOrCreateArray(
@@ -1622,7 +1858,11 @@ void codegenExternalProcedure(ExternalProcedurePtr x, bool codegenBody)
     if (!x->body)
         return;
 
-    CodegenContext ctx(x->llvmFunc);
+    llvm::Function *bodyFunc = x->llvmFunc;
+    if (x->attrMultiversion)
+        bodyFunc = codegenMultiversionDispatch(x);
+
+    CodegenContext ctx(bodyFunc);
 
     if (llvmDIBuilder != NULL) {
         ctx.pushDebugScope(llvmDIBuilder->createLexicalBlock(
@@ -1652,7 +1892,7 @@ void codegenExternalProcedure(ExternalProcedurePtr x, bool codegenBody)
     EnvPtr env = new Env(x->env);
     vector<CReturn> returns;
 
-    llvm::Function::arg_iterator ai = x->llvmFunc->arg_begin();
+    llvm::Function::arg_iterator ai = bodyFunc->arg_begin();
 
     extFunc->allocReturnValue(extFunc->retInfo, ai, returns, &ctx);
 
@@ -1661,7 +1901,7 @@ void codegenExternalProcedure(ExternalProcedurePtr x, bool codegenBody)
         CValuePtr cvalue = extFunc->allocArgumentValue(
             extFunc->argInfos[i], arg->name->str, ai, &ctx);
         addLocal(env, arg->name, cvalue.ptr());
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             unsigned line, column;
             Location argLocation = arg->location;
             llvm::DIFile file = getDebugLineCol(argLocation, line, column);
@@ -1696,8 +1936,7 @@ void codegenExternalProcedure(ExternalProcedurePtr x, bool codegenBody)
         if (x->returnType2.ptr()) {
             error(x, "not all paths have a return statement");
         }
-        cgDestroyStack(returnTarget.stackMarker, &ctx, false);
-        ctx.builder->CreateBr(returnBlock);
+        cgDestroyStackAndBranch(returnTarget.stackMarker, returnBlock, &ctx, false);
     }
     cgPopStack(returnTarget.stackMarker, &ctx);
 
@@ -2081,7 +2320,7 @@ static void codegenIntrinsic(IntrinsicSymbol *intrin, MultiCValue *args,
     
     assert(args->size() == funTy->getNumParams());
     
-    for (vector<CValuePtr>::const_iterator i = args->values.begin(), end = args->values.end();
+    for (llvm::SmallVectorImpl<CValuePtr>::const_iterator i = args->values.begin(), end = args->values.end();
          i != end;
          ++i)
     {
@@ -2279,19 +2518,15 @@ void codegenDispatch(ObjectPtr obj,
     llvm::Value *llTag = codegenDispatchTag(cvDispatch, ctx);
 
     vector<llvm::BasicBlock *> callBlocks;
-    vector<llvm::BasicBlock *> elseBlocks;
 
-    for (unsigned i = 0; i < memberCount; ++i) {
+    for (unsigned i = 0; i < memberCount; ++i)
         callBlocks.push_back(newBasicBlock("dispatchCase", ctx));
-        elseBlocks.push_back(newBasicBlock("dispatchNext", ctx));
-    }
+    llvm::BasicBlock *invalidBlock = newBasicBlock("dispatchInvalid", ctx);
     llvm::BasicBlock *finalBlock = newBasicBlock("finalBlock", ctx);
 
-    for (unsigned i = 0; i < memberCount; ++i) {
-        llvm::Value *tagCase = llvm::ConstantInt::get(llvmIntType(32), i);
-        llvm::Value *cond = ctx->builder->CreateICmpEQ(llTag, tagCase);
-        ctx->builder->CreateCondBr(cond, callBlocks[i], elseBlocks[i]);
+    codegenProfiledSwitch(llTag, invalidBlock, callBlocks, ctx);
 
+    for (unsigned i = 0; i < memberCount; ++i) {
         ctx->builder->SetInsertPoint(callBlocks[i]);
 
         MultiPValuePtr pvArgs2 = new MultiPValue();
@@ -2307,10 +2542,9 @@ void codegenDispatch(ObjectPtr obj,
         codegenDispatch(obj, args2, pvArgs2, dispatchIndices2, ctx, out);
 
         ctx->builder->CreateBr(finalBlock);
-
-        ctx->builder->SetInsertPoint(elseBlocks[i]);
     }
 
+    ctx->builder->SetInsertPoint(invalidBlock);
     codegenCallValue(staticCValue(operator_invalidDispatch(), ctx),
                      new MultiCValue(cvDispatch),
                      ctx,
@@ -2388,7 +2622,7 @@ void codegenCallValue(CValuePtr callable,
         InvokeEntry* entry = safeAnalyzeCallable(obj, pvArgs->values);
         if (entry->callByName) {
             ExprListPtr objectExprs = new ExprList();
-            for (vector<CValuePtr>::const_iterator i = args->values.begin(), end = args->values.end();
+            for (llvm::SmallVectorImpl<CValuePtr>::const_iterator i = args->values.begin(), end = args->values.end();
                  i != end;
                  ++i)
             {
@@ -2503,6 +2737,189 @@ void codegenCallPointer(CValuePtr x,
 
 
 
+//
+// automatic inlining
+//
+// procedures without an inline attribute whose bodies amount to a few
+// calls or field accesses (forwarding wrappers, accessors, operator
+// shims) are inlined at the call site, sparing the call, its exception
+// check and the value stack cleanup of a separate function.
+//
+
+static const int AUTO_INLINE_MAX_SIZE = 4;
+static const int AUTO_INLINE_MAX_DEPTH = 8;
+// total size inlined into one call site, so that a chain of small wrappers
+// doesn't grow the caller without bound
+static const int AUTO_INLINE_MAX_TOTAL = 16;
+
+// entries whose bodies are currently being inlined, to avoid unrolling
+// recursive procedures
+static vector<InvokeEntry*> inliningEntries;
+
+namespace {
+    class InliningEntryScope {
+    public:
+        InliningEntryScope(InvokeEntry *entry) { inliningEntries.push_back(entry); }
+        ~InliningEntryScope() {
+            assert(!inliningEntries.empty());
+            inliningEntries.pop_back();
+        }
+    };
+}
+
+static bool addInlineSize(ExprPtr expr, int &size);
+static bool addInlineSize(StatementPtr stmt, int &size);
+
+static bool addInlineSize(ExprListPtr exprs, int &size)
+{
+    if (!exprs)
+        return true;
+    for (size_t i = 0; i < exprs->size(); ++i) {
+        if (!addInlineSize(exprs->exprs[i], size))
+            return false;
+    }
+    return true;
+}
+
+static bool addInlineSize(ExprPtr expr, int &size)
+{
+    switch (expr->exprKind) {
+    case BOOL_LITERAL :
+    case INT_LITERAL :
+    case FLOAT_LITERAL :
+    case CHAR_LITERAL :
+    case STRING_LITERAL :
+    case FILE_EXPR :
+    case LINE_EXPR :
+    case COLUMN_EXPR :
+    case ARG_EXPR :
+    case NAME_REF :
+    case STATIC_EXPR :
+        return true;
+    case TUPLE :
+        return addInlineSize(((Tuple *)expr.ptr())->args, size);
+    case PAREN :
+        return addInlineSize(((Paren *)expr.ptr())->args, size);
+    case UNPACK :
+        return addInlineSize(((Unpack *)expr.ptr())->expr, size);
+    case INDEXING : {
+        Indexing *x = (Indexing *)expr.ptr();
+        ++size;
+        return addInlineSize(x->expr, size) && addInlineSize(x->args, size);
+    }
+    case CALL : {
+        Call *x = (Call *)expr.ptr();
+        ++size;
+        return addInlineSize(x->expr, size) && addInlineSize(x->parenArgs, size);
+    }
+    case FIELD_REF :
+        ++size;
+        return addInlineSize(((FieldRef *)expr.ptr())->expr, size);
+    case STATIC_INDEXING :
+        ++size;
+        return addInlineSize(((StaticIndexing *)expr.ptr())->expr, size);
+    case VARIADIC_OP :
+        ++size;
+        return addInlineSize(((VariadicOp *)expr.ptr())->exprs, size);
+    case AND : {
+        And *x = (And *)expr.ptr();
+        size += 2;
+        return addInlineSize(x->expr1, size) && addInlineSize(x->expr2, size);
+    }
+    case OR : {
+        Or *x = (Or *)expr.ptr();
+        size += 2;
+        return addInlineSize(x->expr1, size) && addInlineSize(x->expr2, size);
+    }
+    default :
+        // lambdas, dispatch, eval and the like are never considered small
+        return false;
+    }
+}
+
+static bool addInlineSize(StatementPtr stmt, int &size)
+{
+    if (size > AUTO_INLINE_MAX_SIZE)
+        return false;
+    switch (stmt->stmtKind) {
+    case BLOCK : {
+        Block *x = (Block *)stmt.ptr();
+        for (size_t i = 0; i < x->statements.size(); ++i) {
+            if (!addInlineSize(x->statements[i], size))
+                return false;
+        }
+        return true;
+    }
+    case RETURN :
+        return addInlineSize(((Return *)stmt.ptr())->values, size);
+    case EXPR_STATEMENT :
+        return addInlineSize(((ExprStatement *)stmt.ptr())->expr, size);
+    case ASSIGNMENT : {
+        Assignment *x = (Assignment *)stmt.ptr();
+        ++size;
+        return addInlineSize(x->left, size) && addInlineSize(x->right, size);
+    }
+    case INIT_ASSIGNMENT : {
+        InitAssignment *x = (InitAssignment *)stmt.ptr();
+        ++size;
+        return addInlineSize(x->left, size) && addInlineSize(x->right, size);
+    }
+    case BINDING :
+        ++size;
+        return addInlineSize(((Binding *)stmt.ptr())->values, size);
+    case IF : {
+        If *x = (If *)stmt.ptr();
+        size += 2;
+        for (size_t i = 0; i < x->conditionStatements.size(); ++i) {
+            if (!addInlineSize(x->conditionStatements[i], size))
+                return false;
+        }
+        if (!addInlineSize(x->condition, size))
+            return false;
+        if (!addInlineSize(x->thenPart, size))
+            return false;
+        return !x->elsePart || addInlineSize(x->elsePart, size);
+    }
+    default :
+        return false;
+    }
+}
+
+static bool isSmallCodeBody(InvokeEntry *entry)
+{
+    if (!entry->autoInlineChecked) {
+        entry->autoInlineChecked = true;
+        CodePtr code = entry->code;
+        int size = 0;
+        entry->autoInline = !code->isLLVMBody()
+            && code->body.ptr() != NULL
+            && addInlineSize(code->body, size)
+            && size <= AUTO_INLINE_MAX_SIZE;
+        entry->autoInlineSize = size;
+    }
+    return entry->autoInline;
+}
+
+static bool shouldAutoInline(InvokeEntry *entry, CodegenContext *ctx)
+{
+    if (entry->isInline != IGNORE && entry->isInline != INLINE)
+        return false;
+    // keep a frame per procedure for the debugger; line tables only name
+    // the lines, and inlined statements keep their call site's
+    if (fullDebugInfo())
+        return false;
+    if (ctx->inlineDepth >= AUTO_INLINE_MAX_DEPTH)
+        return false;
+    if (!isSmallCodeBody(entry))
+        return false;
+    if (ctx->autoInlinedSize + entry->autoInlineSize > AUTO_INLINE_MAX_TOTAL)
+        return false;
+    return std::find(inliningEntries.begin(), inliningEntries.end(), entry)
+        == inliningEntries.end();
+}
+
+
+
 //
 // codegenCallCode
 //
@@ -2516,6 +2933,17 @@ void codegenCallCode(InvokeEntry* entry,
         codegenCallInline(entry, args, ctx, out);
         return;
     }
+    // a call outside any inlined body starts a new inlining budget
+    if (ctx->inlineDepth == 0)
+        ctx->autoInlinedSize = 0;
+    if (inlineEnabled() && shouldAutoInline(entry, ctx)) {
+        ctx->autoInlinedSize += entry->autoInlineSize;
+        if (_inlineReport)
+            llvm::errs() << "inline: " << getCodeName(entry)
+                         << " (size " << entry->autoInlineSize << ")\n";
+        codegenCallInline(entry, args, ctx, out);
+        return;
+    }
     if (!entry->llvmFunc)
         codegenCodeBody(entry);
     assert(entry->llvmFunc);
@@ -2577,10 +3005,9 @@ void codegenLowlevelCall(llvm::Value *llCallable,
     assert(ctx->exceptionValue != NULL);
     ctx->builder->CreateStore(ptrResult, ctx->exceptionValue);
     JumpTarget *jt = &ctx->exceptionTargets.back();
-    cgDestroyStack(jt->stackMarker, ctx, true);
+    cgDestroyStackAndBranch(jt->stackMarker, jt->block, ctx, true);
     // jt might be invalidated at this point
     jt = &ctx->exceptionTargets.back();
-    ctx->builder->CreateBr(jt->block);
     ++jt->useCount;
 
     ctx->builder->SetInsertPoint(normal);
@@ -2892,6 +3319,35 @@ static bool blockIsNop(llvm::BasicBlock *codeBlock, llvm::BasicBlock *returnBloc
     return false;
 }
 
+// Function bodies are not generated at the point where an InvokeEntry is
+// first referenced. codegenCodeBody only declares the llvm::Function and
+// queues the body, and codegenPendingCodeBodies later emits the queued
+// bodies in first-referenced order, restoring the compile context that was
+// active at the first reference so diagnostics are unchanged.
+
+namespace {
+    struct PendingCodeBody {
+        InvokeEntry* entry;
+        string callableName;
+        vector<CompileContextEntry> compileContext;
+        Location location;
+
+        PendingCodeBody(InvokeEntry* entry, llvm::StringRef callableName)
+            : entry(entry), callableName(callableName),
+              compileContext(getCompileContext()),
+              location(topLocation()) {}
+    };
+}
+
+static std::deque<PendingCodeBody> pendingCodeBodies;
+
+// entries whose llvm::Function was created by codegenCodeBody, in creation
+// order; used by pruneUnreachableCodeBodies
+static vector<InvokeEntry*> codegennedEntries;
+
+static void codegenCodeBodyDefinition(InvokeEntry* entry,
+                                      llvm::StringRef callableName);
+
 void codegenCodeBody(InvokeEntry* entry)
 {
     assert(entry->analyzed);
@@ -2901,6 +3357,7 @@ void codegenCodeBody(InvokeEntry* entry)
 
     if (entry->code->isLLVMBody()) {
         codegenLLVMBody(entry, callableName);
+        codegennedEntries.push_back(entry);
         return;
     }
 
@@ -2946,6 +3403,331 @@ void codegenCodeBody(InvokeEntry* entry)
     }
 
     entry->llvmFunc = llFunc;
+    codegennedEntries.push_back(entry);
+
+    if (eagerCodeBodies > 0)
+        codegenCodeBodyDefinition(entry, callableName);
+    else
+        pendingCodeBodies.push_back(PendingCodeBody(entry, callableName));
+}
+// the queued bodies' functions are dropped, so that they are generated
+// afresh if they are referenced again
+static void discardPendingCodeBodies()
+{
+    for (size_t i = 0; i < pendingCodeBodies.size(); ++i) {
+        InvokeEntry *entry = pendingCodeBodies[i].entry;
+        entry->llvmFunc->replaceAllUsesWith(
+            llvm::UndefValue::get(entry->llvmFunc->getType()));
+        entry->llvmFunc->eraseFromParent();
+        entry->llvmFunc = NULL;
+        codegennedEntries.erase(std::remove(codegennedEntries.begin(),
+                                            codegennedEntries.end(),
+                                            entry),
+                                codegennedEntries.end());
+    }
+    pendingCodeBodies.clear();
+}
+
+//
+// calls to procedures whose bodies turned out to do nothing at runtime
+// were emitted before the body was known; drop them now
+//
+
+static void elideRuntimeNopCalls(llvm::Function *llFunc)
+{
+    vector<llvm::CallInst*> calls;
+    for (llvm::Value::use_iterator ui = llFunc->use_begin(), ue = llFunc->use_end();
+         ui != ue; ++ui)
+    {
+        llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(*ui);
+        if (call != NULL && call->getCalledValue() == llFunc)
+            calls.push_back(call);
+    }
+    for (size_t i = 0; i < calls.size(); ++i) {
+        calls[i]->replaceAllUsesWith(noExceptionReturnValue());
+        calls[i]->eraseFromParent();
+    }
+}
+
+void codegenPendingCodeBodies(bool referencedOnly)
+{
+    vector<InvokeEntry*> nopEntries;
+    vector<CompileContextEntry> savedContext = getCompileContext();
+    // with referencedOnly, bodies whose function has no uses yet are rotated
+    // to the back of the queue; stop after a full rotation without progress
+    size_t skipped = 0;
+    while (skipped < pendingCodeBodies.size()) {
+        PendingCodeBody pending = pendingCodeBodies.front();
+        pendingCodeBodies.pop_front();
+
+        if (referencedOnly && pending.entry->llvmFunc->use_empty()) {
+            pendingCodeBodies.push_back(pending);
+            ++skipped;
+            continue;
+        }
+        skipped = 0;
+
+        setCompileContext(pending.compileContext);
+        LocationContext loc(pending.location);
+        codegenCodeBodyDefinition(pending.entry, pending.callableName);
+        if (pending.entry->runtimeNop)
+            nopEntries.push_back(pending.entry);
+    }
+    setCompileContext(savedContext);
+
+    for (size_t i = 0; i < nopEntries.size(); ++i)
+        elideRuntimeNopCalls(nopEntries[i]->llvmFunc);
+}
+
+
+
+//
+// propagateNoThrow
+//
+// every call to a Clay procedure is followed by a check of the returned
+// exception (see codegenLowlevelCall). procedures that can be shown never
+// to return an exception have those checks removed from their callers,
+// together with the landing blocks that become unreachable. starting from
+// the assumption that every procedure is nothrow, procedures with a
+// reachable `ret` of anything but null are discarded until nothing changes,
+// so recursive procedures are handled too.
+//
+
+// if `branch` is the exception check after a call, the called function
+static llvm::Function *exceptionCheckedCallee(llvm::BranchInst *branch)
+{
+    if (!branch->isConditional())
+        return NULL;
+    llvm::ICmpInst *cmp = llvm::dyn_cast<llvm::ICmpInst>(branch->getCondition());
+    if (cmp == NULL || cmp->getPredicate() != llvm::ICmpInst::ICMP_EQ)
+        return NULL;
+    llvm::IntToPtrInst *ptrResult = llvm::dyn_cast<llvm::IntToPtrInst>(cmp->getOperand(0));
+    if (ptrResult == NULL)
+        return NULL;
+    llvm::CallInst *expect = llvm::dyn_cast<llvm::CallInst>(ptrResult->getOperand(0));
+    if (expect == NULL || expect->getCalledFunction() == NULL
+        || expect->getCalledFunction()->getIntrinsicID() != llvm::Intrinsic::expect)
+        return NULL;
+    llvm::PtrToIntInst *intResult = llvm::dyn_cast<llvm::PtrToIntInst>(expect->getArgOperand(0));
+    if (intResult == NULL)
+        return NULL;
+    llvm::CallInst *call = llvm::dyn_cast<llvm::CallInst>(intResult->getOperand(0));
+    if (call == NULL)
+        return NULL;
+    return call->getCalledFunction();
+}
+
+static bool mayReturnException(llvm::Function *f,
+                               llvm::SmallPtrSet<llvm::Function*, 64> const &noThrow)
+{
+    llvm::SmallPtrSet<llvm::BasicBlock*, 32> visited;
+    vector<llvm::BasicBlock*> worklist;
+    worklist.push_back(&f->getEntryBlock());
+    visited.insert(&f->getEntryBlock());
+    while (!worklist.empty()) {
+        llvm::BasicBlock *bb = worklist.back();
+        worklist.pop_back();
+        llvm::TerminatorInst *term = bb->getTerminator();
+        if (llvm::ReturnInst *ret = llvm::dyn_cast<llvm::ReturnInst>(term)) {
+            llvm::Value *value = ret->getReturnValue();
+            if (value != NULL && !llvm::isa<llvm::ConstantPointerNull>(value))
+                return true;
+            continue;
+        }
+        unsigned numSuccessors = term->getNumSuccessors();
+        if (llvm::BranchInst *branch = llvm::dyn_cast<llvm::BranchInst>(term)) {
+            llvm::Function *callee = exceptionCheckedCallee(branch);
+            if (callee != NULL && noThrow.count(callee))
+                numSuccessors = 1; // only the "normal" successor
+        }
+        for (unsigned i = 0; i < numSuccessors; ++i) {
+            llvm::BasicBlock *succ = term->getSuccessor(i);
+            if (visited.insert(succ))
+                worklist.push_back(succ);
+        }
+    }
+    return false;
+}
+
+static void removeUnreachableBlocks(llvm::Function *f)
+{
+    llvm::SmallPtrSet<llvm::BasicBlock*, 32> reachable;
+    vector<llvm::BasicBlock*> worklist;
+    worklist.push_back(&f->getEntryBlock());
+    reachable.insert(&f->getEntryBlock());
+    while (!worklist.empty()) {
+        llvm::BasicBlock *bb = worklist.back();
+        worklist.pop_back();
+        for (llvm::succ_iterator si = llvm::succ_begin(bb), se = llvm::succ_end(bb);
+             si != se; ++si)
+        {
+            if (reachable.insert(*si))
+                worklist.push_back(*si);
+        }
+    }
+
+    vector<llvm::BasicBlock*> dead;
+    for (llvm::Function::iterator bb = f->begin(); bb != f->end(); ++bb) {
+        if (!reachable.count(&*bb))
+            dead.push_back(&*bb);
+    }
+    for (size_t i = 0; i < dead.size(); ++i) {
+        for (llvm::succ_iterator si = llvm::succ_begin(dead[i]), se = llvm::succ_end(dead[i]);
+             si != se; ++si)
+        {
+            if (reachable.count(*si))
+                (*si)->removePredecessor(dead[i]);
+        }
+    }
+    for (size_t i = 0; i < dead.size(); ++i)
+        dead[i]->dropAllReferences();
+    for (size_t i = 0; i < dead.size(); ++i)
+        dead[i]->eraseFromParent();
+}
+
+static void propagateNoThrow()
+{
+    if (!exceptionsEnabled() || !_noThrowPropagation)
+        return;
+
+    vector<llvm::Function*> candidates;
+    llvm::SmallPtrSet<llvm::Function*, 64> noThrow;
+    for (size_t i = 0; i < codegennedEntries.size(); ++i) {
+        llvm::Function *f = codegennedEntries[i]->llvmFunc;
+        if (f != NULL && !f->isDeclaration() && noThrow.insert(f))
+            candidates.push_back(f);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            llvm::Function *f = candidates[i];
+            if (noThrow.count(f) && mayReturnException(f, noThrow)) {
+                noThrow.erase(f);
+                changed = true;
+            }
+        }
+    }
+
+    for (llvm::Module::iterator f = llvmModule->begin(); f != llvmModule->end(); ++f) {
+        vector<llvm::BranchInst*> checks;
+        for (llvm::Function::iterator bb = f->begin(); bb != f->end(); ++bb) {
+            llvm::BranchInst *branch = llvm::dyn_cast<llvm::BranchInst>(bb->getTerminator());
+            if (branch == NULL)
+                continue;
+            llvm::Function *callee = exceptionCheckedCallee(branch);
+            if (callee != NULL && noThrow.count(callee))
+                checks.push_back(branch);
+        }
+        if (checks.empty())
+            continue;
+        // conditions may sit in blocks that become unreachable, so they are
+        // cleaned up through weak handles after the blocks are removed
+        vector<llvm::WeakVH> conds;
+        for (size_t i = 0; i < checks.size(); ++i) {
+            llvm::BranchInst *branch = checks[i];
+            conds.push_back(llvm::WeakVH(branch->getCondition()));
+            llvm::BranchInst::Create(branch->getSuccessor(0), branch);
+            branch->eraseFromParent();
+        }
+        removeUnreachableBlocks(&*f);
+        for (size_t i = 0; i < conds.size(); ++i) {
+            if (conds[i] != NULL)
+                llvm::RecursivelyDeleteTriviallyDeadInstructions(conds[i]);
+        }
+    }
+}
+
+//
+// pruneUnreachableCodeBodies
+//
+// bodies that are only needed by the evaluator, or whose only callers sit
+// in other unreachable bodies, are removed once the whole program has been
+// generated. roots are every function not owned by an InvokeEntry (entry
+// points, external procedures, C wrappers, ctors/dtors) and the
+// initializers of all globals.
+//
+
+static void markReachable(llvm::Value *v,
+                          llvm::SmallPtrSet<llvm::Constant*, 64> &visited,
+                          vector<llvm::Function*> &worklist)
+{
+    llvm::Constant *c = llvm::dyn_cast<llvm::Constant>(v);
+    if (c == NULL || !visited.insert(c))
+        return;
+    if (llvm::Function *f = llvm::dyn_cast<llvm::Function>(c)) {
+        worklist.push_back(f);
+        return;
+    }
+    if (llvm::isa<llvm::GlobalValue>(c))
+        return;
+    for (unsigned i = 0; i < c->getNumOperands(); ++i)
+        markReachable(c->getOperand(i), visited, worklist);
+}
+
+static void pruneUnreachableCodeBodies()
+{
+    llvm::DenseMap<llvm::Function*, InvokeEntry*> owners;
+    for (size_t i = 0; i < codegennedEntries.size(); ++i) {
+        InvokeEntry *entry = codegennedEntries[i];
+        if (entry->llvmFunc != NULL)
+            owners[entry->llvmFunc] = entry;
+    }
+
+    llvm::SmallPtrSet<llvm::Constant*, 64> visited;
+    vector<llvm::Function*> worklist;
+    for (llvm::Module::iterator f = llvmModule->begin(); f != llvmModule->end(); ++f) {
+        if (owners.find(&*f) == owners.end())
+            markReachable(&*f, visited, worklist);
+    }
+    for (llvm::Module::global_iterator g = llvmModule->global_begin();
+         g != llvmModule->global_end(); ++g)
+    {
+        if (g->hasInitializer())
+            markReachable(g->getInitializer(), visited, worklist);
+    }
+    while (!worklist.empty()) {
+        llvm::Function *f = worklist.back();
+        worklist.pop_back();
+        for (llvm::Function::iterator bb = f->begin(); bb != f->end(); ++bb) {
+            for (llvm::BasicBlock::iterator inst = bb->begin(); inst != bb->end(); ++inst) {
+                for (unsigned i = 0; i < inst->getNumOperands(); ++i)
+                    markReachable(inst->getOperand(i), visited, worklist);
+            }
+        }
+    }
+
+    vector<InvokeEntry*> unreachable;
+    for (size_t i = 0; i < codegennedEntries.size(); ++i) {
+        InvokeEntry *entry = codegennedEntries[i];
+        if (entry->llvmFunc != NULL && !visited.count(entry->llvmFunc))
+            unreachable.push_back(entry);
+    }
+    for (size_t i = 0; i < unreachable.size(); ++i)
+        unreachable[i]->llvmFunc->dropAllReferences();
+    for (size_t i = 0; i < unreachable.size(); ++i) {
+        InvokeEntry *entry = unreachable[i];
+        if (_reportUnreachable)
+            llvm::errs() << "unreachable: " << getCodeName(entry) << "\n";
+        entry->llvmFunc->replaceAllUsesWith(
+            llvm::UndefValue::get(entry->llvmFunc->getType()));
+        entry->llvmFunc->eraseFromParent();
+        entry->llvmFunc = NULL;
+        entry->runtimeNop = false;
+    }
+
+    // dropped entries are generated afresh if they are referenced again
+    // (e.g. from the repl)
+    pendingCodeBodies.clear();
+    codegennedEntries.clear();
+}
+
+static void codegenCodeBodyDefinition(InvokeEntry* entry,
+                                      llvm::StringRef callableName)
+{
+    llvm::Function *llFunc = entry->llvmFunc;
+    string llvmFuncName = callableName;
 
     CodegenContext ctx(entry->llvmFunc);
 
@@ -2956,27 +3738,30 @@ void codegenCodeBody(InvokeEntry* entry)
 
         vector<llvm::Value*> debugParamTypes;
         debugParamTypes.push_back(llvmVoidTypeDebugInfo());
-        for (size_t i = 0; i < entry->argsKey.size(); ++i) {
-            llvm::DIType argType = llvmTypeDebugInfo(entry->argsKey[i]);
-            llvm::DIType argRefType
-                = llvmDIBuilder->createReferenceType(
-                    llvm::dwarf::DW_TAG_reference_type,
-                    argType);
-            debugParamTypes.push_back(argRefType);
-        }
-        for (size_t i = 0; i < entry->returnTypes.size(); ++i) {
-            llvm::DIType returnType = llvmTypeDebugInfo(entry->returnTypes[i]);
-            llvm::DIType returnRefType = entry->returnIsRef[i]
-                ? llvmDIBuilder->createReferenceType(
-                    llvm::dwarf::DW_TAG_reference_type,
-                    llvmDIBuilder->createReferenceType(
+        // line tables only need the subprogram, not its signature
+        if (fullDebugInfo()) {
+            for (size_t i = 0; i < entry->argsKey.size(); ++i) {
+                llvm::DIType argType = llvmTypeDebugInfo(entry->argsKey[i]);
+                llvm::DIType argRefType
+                    = llvmDIBuilder->createReferenceType(
                         llvm::dwarf::DW_TAG_reference_type,
-                        returnType))
-                : llvmDIBuilder->createReferenceType(
-                    llvm::dwarf::DW_TAG_reference_type,
-                    returnType);
+                        argType);
+                debugParamTypes.push_back(argRefType);
+            }
+            for (size_t i = 0; i < entry->returnTypes.size(); ++i) {
+                llvm::DIType returnType = llvmTypeDebugInfo(entry->returnTypes[i]);
+                llvm::DIType returnRefType = entry->returnIsRef[i]
+                    ? llvmDIBuilder->createReferenceType(
+                        llvm::dwarf::DW_TAG_reference_type,
+                        llvmDIBuilder->createReferenceType(
+                            llvm::dwarf::DW_TAG_reference_type,
+                            returnType))
+                    : llvmDIBuilder->createReferenceType(
+                        llvm::dwarf::DW_TAG_reference_type,
+                        returnType);
 
-            debugParamTypes.push_back(returnRefType);
+                debugParamTypes.push_back(returnRefType);
+            }
         }
 
         llvm::DIArray debugParamArray = llvmDIBuilder->getOrCreateArray(
@@ -3024,6 +3809,9 @@ void codegenCodeBody(InvokeEntry* entry)
 
     ctx.exceptionValue = ctx.initBuilder->CreateAlloca(exceptionReturnType(), NULL, "exception");
 
+    ctx.profileKey = profileKey(entry);
+    codegenProfileFunctionEntry(&ctx);
+
     EnvPtr env = new Env(entry->env);
 
     llvm::Function::arg_iterator ai = llFunc->arg_begin();
@@ -3034,7 +3822,7 @@ void codegenCodeBody(InvokeEntry* entry)
         llArgValue->setName(entry->fixedArgNames[i]->str.str());
         CValuePtr cvalue = new CValue(entry->fixedArgTypes[i], llArgValue, entry->forwardedRValueFlags[i]);
         addLocal(env, entry->fixedArgNames[i], cvalue.ptr());
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             unsigned line, column;
             Location argLocation = entry->origCode->formalArgs[i]->location;
             llvm::DIFile file = getDebugLineCol(argLocation, line, column);
@@ -3079,7 +3867,7 @@ void codegenCodeBody(InvokeEntry* entry)
             CValuePtr cvalue = new CValue(entry->varArgTypes[j], llArgValue, entry->forwardedRValueFlags[i+j]);
             varArgs->add(cvalue);
 
-            if (llvmDIBuilder != NULL) {
+            if (fullDebugInfo()) {
                 llvm::DebugLoc debugLoc = llvm::DebugLoc::get(line, column, entry->getDebugInfo());
                 llvm::DIVariable debugVar = llvmDIBuilder->createLocalVariable(
                     llvm::dwarf::DW_TAG_arg_variable, // tag
@@ -3110,7 +3898,7 @@ void codegenCodeBody(InvokeEntry* entry)
             llArgValue->setName(entry->fixedArgNames[i]->str.str());
             CValuePtr cvalue = new CValue(entry->fixedArgTypes[i], llArgValue, entry->forwardedRValueFlags[i+j]);
             addLocal(env, entry->fixedArgNames[i], cvalue.ptr());
-            if (llvmDIBuilder != NULL) {
+            if (fullDebugInfo()) {
                 unsigned line, column;
                 Location argLocation = entry->origCode->formalArgs[i]->location;
                 llvm::DIFile file = getDebugLineCol(argLocation, line, column);
@@ -3170,7 +3958,7 @@ void codegenCodeBody(InvokeEntry* entry)
                 sout << "return.." << i;
             returns[i].value->llValue->setName(sout.str());
 
-            if (rspec->name != NULL && llvmDIBuilder != NULL) {
+            if (rspec->name != NULL && fullDebugInfo()) {
                 unsigned line, column;
                 Location argLocation = rspec->location;
                 llvm::DIFile file = getDebugLineCol(argLocation, line, column);
@@ -3222,8 +4010,7 @@ void codegenCodeBody(InvokeEntry* entry)
         if ((returns.size() > 0) && !hasNamedReturn) {
             error(entry->code, "not all paths have a return statement");
         }
-        cgDestroyStack(returnTarget.stackMarker, &ctx, false);
-        ctx.builder->CreateBr(returnBlock);
+        cgDestroyStackAndBranch(returnTarget.stackMarker, returnBlock, &ctx, false);
     }
     cgPopStack(returnTarget.stackMarker, &ctx);
 
@@ -3255,12 +4042,13 @@ void codegenCallInline(InvokeEntry* entry,
                        CodegenContext* ctx,
                        MultiCValuePtr out)
 {
-    assert(entry->isInline==FORCE_INLINE);
+    assert(entry->isInline==FORCE_INLINE || entry->autoInline);
     assert(ctx->inlineDepth >= 0);
     if (entry->code->isLLVMBody())
         error(entry->code, "llvm procedures cannot be inlined");
 
     ++ctx->inlineDepth;
+    InliningEntryScope inlining(entry);
 
     ensureArity(args, entry->argsKey.size());
 
@@ -3336,8 +4124,7 @@ void codegenCallInline(InvokeEntry* entry,
         if ((returns.size() > 0) && !hasNamedReturn) {
             error(entry->code, "not all paths have a return statement");
         }
-        cgDestroyStack(returnTarget.stackMarker, ctx, false);
-        ctx->builder->CreateBr(returnBlock);
+        cgDestroyStackAndBranch(returnTarget.stackMarker, returnBlock, ctx, false);
     }
     cgPopStack(returnTarget.stackMarker, ctx);
 
@@ -3449,8 +4236,7 @@ void codegenCallByName(InvokeEntry* entry,
         if ((returns.size() > 0) && !hasNamedReturn) {
             error(entry->code, "not all paths have a return statement");
         }
-        cgDestroyStack(returnTarget.stackMarker, ctx, false);
-        ctx->builder->CreateBr(returnBlock);
+        cgDestroyStackAndBranch(returnTarget.stackMarker, returnBlock, ctx, false);
     }
     cgPopStack(returnTarget.stackMarker, ctx);
 
@@ -3549,7 +4335,7 @@ static EnvPtr codegenStatementExpressionStatements(llvm::ArrayRef<StatementPtr>
 
 static size_t codegenBeginScope(StatementPtr scopeStmt, CodegenContext* ctx)
 {
-    if (llvmDIBuilder != NULL) {
+    if (fullDebugInfo()) {
         llvm::DILexicalBlock outerScope = ctx->getDebugScope();
         unsigned line, column;
         llvm::DIFile file = getDebugLineCol(scopeStmt->location, line, column);
@@ -3568,7 +4354,7 @@ static void codegenEndScope(size_t marker, bool terminated, CodegenContext* ctx)
     if (!terminated)
         cgDestroyStack(marker, ctx, false);
     cgPopStack(marker, ctx);
-    if (llvmDIBuilder != NULL)
+    if (fullDebugInfo())
         ctx->popDebugScope();
 }
 
@@ -3748,8 +4534,7 @@ bool codegenStatement(StatementPtr stmt,
             error(sout.str());
         }
         JumpTarget &jt = li->second;
-        cgDestroyStack(jt.stackMarker, ctx, false);
-        ctx->builder->CreateBr(jt.block);
+        cgDestroyStackAndBranch(jt.stackMarker, jt.block, ctx, false);
         ++ jt.useCount;
         return true;
     }
@@ -3793,10 +4578,9 @@ bool codegenStatement(StatementPtr stmt,
             assert(false);
         }
         JumpTarget *jt = &ctx->returnTargets.back();
-        cgDestroyStack(jt->stackMarker, ctx, false);
+        cgDestroyStackAndBranch(jt->stackMarker, jt->block, ctx, false);
         // jt might be invalidated at this point
         jt = &ctx->returnTargets.back();
-        ctx->builder->CreateBr(jt->block);
         ++ jt->useCount;
         return true;
     }
@@ -3826,7 +4610,7 @@ bool codegenStatement(StatementPtr stmt,
 
         if (condBoolKind == BOOL_EXPR) {
             llvm::Value *cond = codegenToBoolFlag(cv, ctx);
-            ctx->builder->CreateCondBr(cond, trueBlock, falseBlock);
+            codegenProfiledCondBr(cond, trueBlock, falseBlock, ctx);
         } else {
             ctx->builder->CreateBr(condBoolKind == BOOL_STATIC_TRUE ? trueBlock : falseBlock);
         }
@@ -3917,7 +4701,7 @@ bool codegenStatement(StatementPtr stmt,
         cgDestroyAndPopStack(marker, ctx, false);
         clearTemps(tempMarker, ctx);
 
-        ctx->builder->CreateCondBr(cond, whileBody, whileEnd);
+        codegenProfiledCondBr(cond, whileBody, whileEnd, ctx);
 
         ctx->breaks.push_back(JumpTarget(whileEnd, cgMarkStack(ctx)));
         ctx->continues.push_back(JumpTarget(whileContinue, cgMarkStack(ctx)));
@@ -3953,10 +4737,9 @@ bool codegenStatement(StatementPtr stmt,
         if (ctx->breaks.empty())
             error("invalid break statement");
         JumpTarget *jt = &ctx->breaks.back();
-        cgDestroyStack(jt->stackMarker, ctx, false);
+        cgDestroyStackAndBranch(jt->stackMarker, jt->block, ctx, false);
         // jt might be invalidated at this point
         jt = &ctx->breaks.back();
-        ctx->builder->CreateBr(jt->block);
         ++ jt->useCount;
         return true;
     }
@@ -3965,10 +4748,9 @@ bool codegenStatement(StatementPtr stmt,
         if (ctx->continues.empty())
             error("invalid continue statement");
         JumpTarget *jt = &ctx->continues.back();
-        cgDestroyStack(jt->stackMarker, ctx, false);
+        cgDestroyStackAndBranch(jt->stackMarker, jt->block, ctx, false);
         // jt might be invalidated at this point
         jt = &ctx->continues.back();
-        ctx->builder->CreateBr(jt->block);
         ++ jt->useCount;
         return true;
     }
@@ -4169,7 +4951,7 @@ EnvPtr codegenBinding(BindingPtr x, EnvPtr env, CodegenContext* ctx)
         for (unsigned i = 0; i < mpv->values.size(); ++i) {
             CValuePtr cv = codegenAllocNewValue(mpv->values[i].type, ctx);
             mcv->add(cv);
-            if (llvmDIBuilder != NULL) {
+            if (fullDebugInfo()) {
                 llvm::DILexicalBlock debugBlock = ctx->getDebugScope();
                 llvm::DIVariable debugVar = llvmDIBuilder->createLocalVariable(
                     llvm::dwarf::DW_TAG_auto_variable, // tag
@@ -4238,7 +5020,7 @@ EnvPtr codegenBinding(BindingPtr x, EnvPtr env, CodegenContext* ctx)
             TypePtr ptrType = pointerType(pv.type);
             CValuePtr cvRef = codegenAllocNewValue(ptrType, ctx);
             mcv->add(cvRef);
-            if (llvmDIBuilder != NULL) {
+            if (fullDebugInfo()) {
                 llvm::DILexicalBlock debugBlock = ctx->getDebugScope();
                 llvm::DIVariable debugVar = llvmDIBuilder->createLocalVariable(
                     llvm::dwarf::DW_TAG_auto_variable, // tag
@@ -4311,7 +5093,7 @@ EnvPtr codegenBinding(BindingPtr x, EnvPtr env, CodegenContext* ctx)
                 cv = codegenAllocNewValue(ptrType, ctx);
             }
             mcv->add(cv);
-            if (llvmDIBuilder != NULL) {
+            if (fullDebugInfo()) {
                 llvm::DILexicalBlock debugBlock = ctx->getDebugScope();
                 llvm::DIType debugType = llvmTypeDebugInfo(pv.type);
                 llvm::DIVariable debugVar = llvmDIBuilder->createLocalVariable(
@@ -4783,6 +5565,7 @@ void codegenEntryPoints(ModulePtr module, bool importedExternals)
     codegenTopLevelLLVM(module);
     initializeCtorsDtors();
     generateLLVMCtorsAndDtors();
+    codegenProfileWriterRegistration(constructorsCtx);
     codegenModuleEntryPoints(module, importedExternals);
 
     ObjectPtr mainProc = lookupPrivate(module, Identifier::get("main"));
@@ -4793,7 +5576,12 @@ void codegenEntryPoints(ModulePtr module, bool importedExternals)
     if (mainProc != NULL && mainProc->objKind != EXTERNAL_PROCEDURE)
         codegenMain(module);
 
+    codegenPendingCodeBodies(true);
     finalizeCtorsDtors();
+    codegenPendingCodeBodies(true);
+    propagateNoThrow();
+    pruneUnreachableCodeBodies();
+    codegenProfileWriter();
 
     if (llvmDIBuilder != NULL)
         llvmDIBuilder->finalize();
@@ -4882,6 +5670,11 @@ llvm::TargetMachine *initLLVM(llvm::StringRef targetTriple,
     return targetMachine;
 }
 
+// imports and top level items of the repl module that have been
+// generated by earlier inputs
+static size_t replImportsGenerated = 0;
+static size_t replItemsGenerated = 0;
+
 void codegenBeforeRepl(ModulePtr module) {
     CodegenContext* theConstructorCtx = new CodegenContext();
     CodegenContext* theDestructorCtx = new CodegenContext();
@@ -4889,17 +5682,38 @@ void codegenBeforeRepl(ModulePtr module) {
     delete destructorsCtx;
     constructorsCtx = theConstructorCtx;
     destructorsCtx = theDestructorCtx;
-    //codegenTopLevelLLVM(module);
-    codegenTopLevelLLVMRecursive(module);
+
+    // the constructor and destructor of each input only cover the globals
+    // that the input initializes
+    initializedGlobals.clear();
+
+    for (; replImportsGenerated < module->imports.size(); ++replImportsGenerated)
+        codegenTopLevelLLVMRecursive(module->imports[replImportsGenerated]->module);
     initializeCtorsDtors();
-    generateLLVMCtorsAndDtors();
-    codegenModuleEntryPoints(module, false);
+    // the repl runs each input's constructor itself, so there is no
+    // llvm.global_ctors entry to generate
+    for (; replItemsGenerated < module->topLevelItems.size(); ++replItemsGenerated) {
+        TopLevelItemPtr x = module->topLevelItems[replItemsGenerated];
+        if (x->objKind == EXTERNAL_PROCEDURE) {
+            ExternalProcedurePtr y = (ExternalProcedure *)x.ptr();
+            if (y->body.ptr())
+                codegenExternalProcedure(y, true);
+        }
+    }
 }
 
 void codegenAfterRepl(llvm::Function*& ctor, llvm::Function*& dtor) {
+    codegenPendingCodeBodies();
+    bool hasDestructors = !initializedGlobals.empty();
     finalizeCtorsDtors();
+    codegenPendingCodeBodies();
     ctor = constructorsCtx->llvmFunc;
     dtor = destructorsCtx->llvmFunc;
+    if (!hasDestructors && dtor->use_empty()) {
+        dtor->eraseFromParent();
+        destructorsCtx->llvmFunc = NULL;
+        dtor = NULL;
+    }
 }
 
 }
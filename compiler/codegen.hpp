@@ -13,6 +13,11 @@ extern llvm::Module *llvmModule;
 extern llvm::DIBuilder *llvmDIBuilder;
 extern const llvm::DataLayout *llvmDataLayout;
 
+// with line tables only, -g describes procedures and source locations but
+// emits no type or variable descriptors
+bool fullDebugInfo();
+void setDebugLineTablesOnly(bool enabled);
+
 llvm::PointerType *exceptionReturnType();
 llvm::Value *noExceptionReturnValue();
 
@@ -30,6 +35,9 @@ bool inlineEnabled();
 void setInlineEnabled(bool enabled);
 bool exceptionsEnabled();
 void setExceptionsEnabled(bool enabled);
+void setNoThrowPropagation(bool enabled);
+void setReportUnreachable(bool enabled);
+void setInlineReport(bool enabled);
 
 
 void initExternalTarget(string target);
@@ -49,7 +57,7 @@ struct CValue : public Object {
 };
 
 struct MultiCValue : public Object {
-    vector<CValuePtr> values;
+    llvm::SmallVector<CValuePtr, 4> values;
     MultiCValue()
         : Object(MULTI_CVALUE) {}
     MultiCValue(CValuePtr pv)
@@ -57,7 +65,7 @@ struct MultiCValue : public Object {
         values.push_back(pv);
     }
     MultiCValue(llvm::ArrayRef<CValuePtr> values)
-        : Object(MULTI_CVALUE), values(values) {}
+        : Object(MULTI_CVALUE), values(values.begin(), values.end()) {}
     size_t size() { return values.size(); }
     void add(CValuePtr x) { values.push_back(x); }
     void add(MultiCValuePtr x) {
@@ -66,7 +74,7 @@ struct MultiCValue : public Object {
 
     void toArgsKey(vector<TypePtr> *types)
     {
-        for (vector<CValuePtr>::const_iterator i = values.begin(), end = values.end();
+        for (CValuePtr const *i = values.begin(), *end = values.end();
              i != end;
              ++i)
         {
@@ -105,11 +113,25 @@ enum ValueStackEntryType {
     ONERROR_STATEMENT
 };
 
+// a block that destroys one value stack entry and the entries below it down
+// to `marker`, then branches to `target`. see cgDestroyStackAndBranch
+struct CleanupBlock {
+    llvm::BasicBlock *target;
+    size_t marker;
+    bool exception;
+    llvm::BasicBlock *block;
+
+    CleanupBlock(llvm::BasicBlock *target, size_t marker, bool exception,
+                 llvm::BasicBlock *block)
+        : target(target), marker(marker), exception(exception), block(block) {}
+};
+
 struct ValueStackEntry {
     ValueStackEntryType type;
     CValuePtr value;
     EnvPtr statementEnv;
     StatementPtr statement;
+    vector<CleanupBlock> cleanups;
 
     explicit ValueStackEntry(CValuePtr value)
         : type(LOCAL_VALUE), value(value), statementEnv(NULL), statement(NULL) {}
@@ -144,14 +166,23 @@ struct CodegenContext {
     int inlineDepth; //:31;
     bool checkExceptions:1;
 
+    // size of the bodies automatically inlined into the current outermost
+    // call site, nested ones included
+    int autoInlinedSize;
+
     int callByNameDepth;
 
+    // identifies the procedure being generated in profiles (see pgo.hpp);
+    // empty for functions that are not code bodies
+    string profileKey;
+
     CodegenContext()
         : llvmFunc(NULL),
           valueForStatics(NULL),
           exceptionValue(NULL),
           inlineDepth(0),
           checkExceptions(true),
+          autoInlinedSize(0),
           callByNameDepth(0)
     {
     }
@@ -162,6 +193,7 @@ struct CodegenContext {
           exceptionValue(NULL),
           inlineDepth(0),
           checkExceptions(true),
+          autoInlinedSize(0),
           callByNameDepth(0)
     {
     }
@@ -217,6 +249,7 @@ struct InvokeEntry;
 InvokeEntry* codegenCallable(ObjectPtr x,
                              llvm::ArrayRef<PVData> args);
 void codegenCodeBody(InvokeEntry* entry);
+void codegenPendingCodeBodies(bool referencedOnly = false);
 void codegenCWrapper(InvokeEntry* entry);
 
 void codegenCallValue(CValuePtr callable,
@@ -0,0 +1,225 @@
+#include "clay.hpp"
+#include "depgraph.hpp"
+#include "error.hpp"
+#include "invoketables.hpp"
+#include "parser.hpp"
+
+namespace clay {
+
+
+uint64_t fnv1aHash(uint64_t hash, llvm::StringRef data)
+{
+    for (size_t i = 0; i < data.size(); ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+//
+// splitSource
+//
+// the file is parsed again with deferred bodies, which gives the extent of
+// every `{ ... }` overload body without depending on how the program itself
+// was loaded. only the number of lines of each body is part of the interface
+// hash, since that moves the locations of everything after it.
+//
+
+struct SourceSplit {
+    SourcePtr source;
+    uint64_t interfaceHash;
+    vector<OverloadPtr> overloads; // those with bodies, in source order
+};
+
+static llvm::StringRef bodyText(OverloadPtr x)
+{
+    const Location &body = x->code->deferredBody;
+    return llvm::StringRef(body.source->data() + body.offset,
+                           x->code->deferredBodyLength);
+}
+
+static string bodyHash(OverloadPtr x)
+{
+    return llvm::utohexstr(fnv1aHash(FNV1A_OFFSET, bodyText(x)));
+}
+
+static bool splitSource(llvm::StringRef fileName,
+                        SourceSplit &split,
+                        string &errorMessage)
+{
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    if (llvm::error_code ec = llvm::MemoryBuffer::getFile(fileName, buffer)) {
+        errorMessage = "unable to open file " + fileName.str() + ": " + ec.message();
+        return false;
+    }
+    split.source = new Source(fileName, buffer.take());
+
+    ModulePtr m;
+    try {
+        m = parse("", split.source, ParserDeferBodies);
+    } catch (CompilerError &) {
+        errorMessage = "unable to parse " + fileName.str();
+        return false;
+    }
+
+    split.overloads.clear();
+    for (size_t i = 0; i < m->topLevelItems.size(); ++i) {
+        TopLevelItem *x = m->topLevelItems[i].ptr();
+        if (x->objKind != OVERLOAD)
+            continue;
+        Overload *y = (Overload *)x;
+        if (y->code->deferredBody.ok())
+            split.overloads.push_back(y);
+    }
+
+    const char *data = split.source->data();
+    unsigned pos = 0;
+    uint64_t hash = FNV1A_OFFSET;
+    for (size_t i = 0; i < split.overloads.size(); ++i) {
+        const Location &body = split.overloads[i]->code->deferredBody;
+        llvm::StringRef text = bodyText(split.overloads[i]);
+        hash = fnv1aHash(hash, llvm::StringRef(data + pos, body.offset - pos));
+        hash = fnv1aHash(hash, "{" + llvm::utostr(text.count('\n')) + "}");
+        pos = body.offset + unsigned(text.size());
+    }
+    hash = fnv1aHash(hash, llvm::StringRef(data + pos, split.source->size() - pos));
+    split.interfaceHash = hash;
+    return true;
+}
+
+
+//
+// writeDependencyGraph
+//
+// "clay-deps-graph 1"
+// "output <output file>"
+// "file <interface hash> <source file>"
+// "body <index> <body hash> <overload name>", for the used bodies of the
+//     preceding file, indexed in source order
+//
+
+typedef set<pair<string, unsigned> > OverloadLocations;
+
+static void usedOverloadLocations(OverloadLocations &used)
+{
+    vector<InvokeSet*> sets = allInvokeSets();
+    for (size_t i = 0; i < sets.size(); ++i) {
+        vector<MatchSuccessPtr> &matches = sets[i]->matches;
+        for (size_t j = 0; j < matches.size(); ++j) {
+            const Location &location = matches[j]->overload->code->location;
+            if (location.ok())
+                used.insert(make_pair(location.source->fileName, location.offset));
+        }
+    }
+}
+
+bool writeDependencyGraph(llvm::StringRef fileName,
+                          llvm::StringRef outputFile,
+                          llvm::ArrayRef<string> sourceFiles,
+                          string &errorMessage)
+{
+    OverloadLocations used;
+    usedOverloadLocations(used);
+
+    llvm::raw_fd_ostream out(fileName.str().c_str(),
+                             errorMessage,
+                             llvm::raw_fd_ostream::F_Binary);
+    if (!errorMessage.empty())
+        return false;
+
+    out << "clay-deps-graph 1\n";
+    out << "output " << outputFile << '\n';
+    for (size_t i = 0; i < sourceFiles.size(); ++i) {
+        SourceSplit split;
+        if (!splitSource(sourceFiles[i], split, errorMessage))
+            return false;
+        out << "file " << llvm::utohexstr(split.interfaceHash)
+            << ' ' << sourceFiles[i] << '\n';
+        for (size_t j = 0; j < split.overloads.size(); ++j) {
+            OverloadPtr x = split.overloads[j];
+            if (used.count(make_pair(sourceFiles[i], x->code->location.offset)))
+                out << "body " << j << ' ' << bodyHash(x)
+                    << ' ' << x->target->asString() << '\n';
+        }
+    }
+    return true;
+}
+
+
+//
+// dependenciesChanged
+//
+
+static bool isListed(llvm::StringRef fileName, llvm::ArrayRef<string> files)
+{
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (fileName == files[i])
+            return true;
+        bool same = false;
+        if (!llvm::sys::fs::equivalent(fileName, files[i], same) && same)
+            return true;
+    }
+    return false;
+}
+
+bool dependenciesChanged(llvm::StringRef graphFile,
+                         llvm::ArrayRef<string> changedFiles,
+                         string &reason)
+{
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    if (llvm::error_code ec = llvm::MemoryBuffer::getFile(graphFile, buffer)) {
+        reason = "unable to open file " + graphFile.str() + ": " + ec.message();
+        return true;
+    }
+
+    llvm::SmallVector<llvm::StringRef, 256> lines;
+    buffer->getBuffer().split(lines, "\n", -1, false);
+    if (lines.empty() || lines[0] != "clay-deps-graph 1") {
+        reason = graphFile.str() + " is not a dependency graph";
+        return true;
+    }
+
+    SourceSplit split;
+    llvm::StringRef fileName;
+    bool checking = false;
+    for (size_t i = 1; i < lines.size(); ++i) {
+        std::pair<llvm::StringRef, llvm::StringRef> line = lines[i].split(' ');
+        if (line.first == "output")
+            continue;
+        if (line.first == "file") {
+            std::pair<llvm::StringRef, llvm::StringRef> file = line.second.split(' ');
+            fileName = file.second;
+            checking = changedFiles.empty() || isListed(fileName, changedFiles);
+            if (!checking)
+                continue;
+            if (!splitSource(fileName, split, reason))
+                return true;
+            if (llvm::utohexstr(split.interfaceHash) != file.first) {
+                reason = "declarations in " + fileName.str() + " have changed";
+                return true;
+            }
+        }
+        else if (line.first == "body" && !fileName.empty()) {
+            if (!checking)
+                continue;
+            std::pair<llvm::StringRef, llvm::StringRef> index = line.second.split(' ');
+            std::pair<llvm::StringRef, llvm::StringRef> body = index.second.split(' ');
+            unsigned j;
+            if (index.first.getAsInteger(10, j)
+                || j >= split.overloads.size()
+                || bodyHash(split.overloads[j]) != body.first)
+            {
+                reason = body.second.str() + " in " + fileName.str() + " has changed";
+                return true;
+            }
+        }
+        else {
+            reason = graphFile.str() + " is not a dependency graph";
+            return true;
+        }
+    }
+    return false;
+}
+
+}
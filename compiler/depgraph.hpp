@@ -0,0 +1,35 @@
+#pragma once
+
+
+#include "clay.hpp"
+
+namespace clay {
+
+
+//
+// symbol-level dependency graph
+//
+// -deps-graph records, for every source file loaded, a hash of everything
+// in the file outside of procedure bodies, followed by the hashes of only
+// those bodies whose overloads were actually instantiated. -check-deps
+// compares such a graph against the current sources: edits to bodies that
+// the output never used do not require a rebuild.
+//
+
+// 64-bit FNV-1a, for hashes that are stored on disk
+static const uint64_t FNV1A_OFFSET = 14695981039346656037ULL;
+uint64_t fnv1aHash(uint64_t hash, llvm::StringRef data);
+
+bool writeDependencyGraph(llvm::StringRef fileName,
+                          llvm::StringRef outputFile,
+                          llvm::ArrayRef<string> sourceFiles,
+                          string &errorMessage);
+
+// returns true if the output described by the graph must be rebuilt, with
+// the reason in `reason`. if `changedFiles` is empty every file in the
+// graph is checked, otherwise only those of `changedFiles` that it lists
+bool dependenciesChanged(llvm::StringRef graphFile,
+                         llvm::ArrayRef<string> changedFiles,
+                         string &reason);
+
+}
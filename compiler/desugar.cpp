@@ -122,24 +122,102 @@ static vector<FormalArgPtr> identVtoFormalV(llvm::ArrayRef<IdentifierPtr> x) {
 // becomes:
 //  {
 //      forward %expr = <expr>;
-//      forward %iter = iterator(%expr);
-//      while (var %value = nextValue(%iter); hasValue?(%value)) {
-//          forward <vars> = getValue(%value);
-//          <body>
+//      if (countedIteration?(%expr)) {
+//          var %begin, %count = countedIterationBounds(%expr);
+//          var %index = SizeT(0);
+//          while (integerLesser?(%index, %count)) {
+//              forward <vars> = index(%begin, %index);
+//              %index = numericAdd(%index, SizeT(1));
+//              <body>
+//          }
+//      } else {
+//          forward %iter = iterator(%expr);
+//          while (var %value = nextValue(%iter); hasValue?(%value)) {
+//              forward <vars> = getValue(%value);
+//              <body>
+//          }
 //      }
 //  }
+// countedIteration? is static, so only one of the loops is compiled. the
+// counted loop has its trip count on entry and no per-element check of a
+// nextValue result, which lets LLVM vectorize loops over contiguous
+// sequences.
+
+static ExprPtr sizeTExpr(llvm::StringRef value, Location const &location) {
+    CallPtr call = new Call(new ObjectExpr(cSizeTType.ptr()), new ExprList());
+    call->location = location;
+    call->parenArgs->add(new IntLiteral(value));
+    return call.ptr();
+}
 
-StatementPtr desugarForStatement(ForPtr x) {
-    IdentifierPtr exprVar = Identifier::get("%expr", x->location);
+static StatementPtr desugarCountedLoop(ForPtr x, IdentifierPtr exprVar) {
+    IdentifierPtr beginVar = Identifier::get("%begin", x->location);
+    IdentifierPtr countVar = Identifier::get("%count", x->location);
+    IdentifierPtr indexVar = Identifier::get("%index", x->location);
+
+    BlockPtr block = new Block();
+    block->location = x->body->location;
+    vector<StatementPtr> &bs = block->statements;
+
+    CallPtr boundsCall = new Call(operator_expr_countedIterationBounds(), new ExprList());
+    boundsCall->location = x->body->location;
+    boundsCall->parenArgs->add(new NameRef(exprVar));
+    vector<IdentifierPtr> boundsVars;
+    boundsVars.push_back(beginVar);
+    boundsVars.push_back(countVar);
+    BindingPtr boundsBinding = new Binding(VAR,
+        identVtoFormalV(boundsVars),
+        new ExprList(boundsCall.ptr()));
+    boundsBinding->location = x->body->location;
+    bs.push_back(boundsBinding.ptr());
+
+    BindingPtr indexBinding = new Binding(VAR,
+        identV(indexVar),
+        new ExprList(sizeTExpr("0", x->body->location)));
+    indexBinding->location = x->body->location;
+    bs.push_back(indexBinding.ptr());
+
+    ExprPtr indexName = new NameRef(indexVar);
+    indexName->location = x->body->location;
+
+    CallPtr lesserCall = new Call(primitive_expr_integerLesserP(), new ExprList());
+    lesserCall->location = x->body->location;
+    lesserCall->parenArgs->add(indexName);
+    lesserCall->parenArgs->add(new NameRef(countVar));
+
+    CallPtr elementCall = new Call(operator_expr_index(), new ExprList());
+    elementCall->location = x->body->location;
+    elementCall->parenArgs->add(new NameRef(beginVar));
+    elementCall->parenArgs->add(indexName);
+
+    CallPtr addCall = new Call(primitive_expr_numericAdd(), new ExprList());
+    addCall->location = x->body->location;
+    addCall->parenArgs->add(indexName);
+    addCall->parenArgs->add(sizeTExpr("1", x->body->location));
+    StatementPtr increment = new Assignment(new ExprList(indexName),
+                                            new ExprList(addCall.ptr()));
+    increment->location = x->body->location;
+
+    BlockPtr whileBody = new Block();
+    whileBody->location = x->body->location;
+    vector<StatementPtr> &ws = whileBody->statements;
+    ws.push_back(new Binding(FORWARD, identVtoFormalV(x->variables), new ExprList(elementCall.ptr())));
+    ws.push_back(increment);
+    ws.push_back(x->body);
+
+    StatementPtr whileStmt = new While(lesserCall.ptr(), whileBody.ptr());
+    whileStmt->location = x->location;
+    bs.push_back(whileStmt);
+    return block.ptr();
+}
+
+static StatementPtr desugarIteratorLoop(ForPtr x, IdentifierPtr exprVar) {
     IdentifierPtr iterVar = Identifier::get("%iter", x->location);
     IdentifierPtr valueVar = Identifier::get("%value", x->location);
 
     BlockPtr block = new Block();
     block->location = x->body->location;
     vector<StatementPtr> &bs = block->statements;
-    BindingPtr exprBinding = new Binding(FORWARD, identV(exprVar), new ExprList(x->expr));
-    exprBinding->location = x->body->location;
-    bs.push_back(exprBinding.ptr());
 
     CallPtr iteratorCall = new Call(operator_expr_iterator(), new ExprList());
     iteratorCall->location = x->body->location;
@@ -185,6 +263,30 @@ StatementPtr desugarForStatement(ForPtr x) {
     return block.ptr();
 }
 
+StatementPtr desugarForStatement(ForPtr x) {
+    IdentifierPtr exprVar = Identifier::get("%expr", x->location);
+
+    BlockPtr block = new Block();
+    block->location = x->body->location;
+    vector<StatementPtr> &bs = block->statements;
+    BindingPtr exprBinding = new Binding(FORWARD, identV(exprVar), new ExprList(x->expr));
+    exprBinding->location = x->body->location;
+    bs.push_back(exprBinding.ptr());
+
+    CallPtr countedCall = new Call(operator_expr_countedIterationP(), new ExprList());
+    countedCall->location = x->body->location;
+    ExprPtr exprName = new NameRef(exprVar);
+    exprName->location = x->location;
+    countedCall->parenArgs->add(exprName);
+
+    StatementPtr ifStmt = new If(countedCall.ptr(),
+                                 desugarCountedLoop(x, exprVar),
+                                 desugarIteratorLoop(x, exprVar));
+    ifStmt->location = x->location;
+    bs.push_back(ifStmt);
+    return block.ptr();
+}
+
 static void makeExceptionVars(vector<IdentifierPtr>& identifiers, CatchPtr x) {
     identifiers.push_back(x->exceptionVar);
     identifiers.push_back(
@@ -447,6 +549,7 @@ llvm::ArrayRef<TopLevelItemPtr> desugarEvalTopLevel(EvalTopLevelPtr eval, EnvPtr
 
 OverloadPtr desugarAsOverload(OverloadPtr &x) {
     assert(x->hasAsConversion);
+    parseDeferredBody(x->code);
 
     //Generate specialised overload
     CodePtr code = new Code();
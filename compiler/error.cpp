@@ -57,7 +57,8 @@ void setCompileContext(llvm::ArrayRef<CompileContextEntry> x) {
 }
 
 CompileContextPusher::CompileContextPusher(ObjectPtr obj, llvm::ArrayRef<PVData> params, llvm::ArrayRef<unsigned> dispatchIndices) {
-    vector<ObjectPtr> params2;
+    llvm::SmallVector<ObjectPtr, 4> params2;
+    params2.reserve(params.size());
     for (unsigned i = 0; i < params.size(); ++i) {
         params2.push_back(params[i].type.ptr());
     }
@@ -1748,7 +1748,7 @@ void evalCallValue(EValuePtr callable,
         InvokeEntry* entry = safeAnalyzeCallable(obj, pvArgs->values);
         if (entry->callByName) {
             ExprListPtr objectExprs = new ExprList();
-            for (vector<EValuePtr>::const_iterator i = args->values.begin();
+            for (llvm::SmallVectorImpl<EValuePtr>::const_iterator i = args->values.begin();
                  i != args->values.end();
                  ++i)
             {
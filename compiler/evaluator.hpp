@@ -25,7 +25,7 @@ struct EValue : public Object {
 };
 
 struct MultiEValue : public Object {
-    vector<EValuePtr> values;
+    llvm::SmallVector<EValuePtr, 4> values;
     MultiEValue()
         : Object(MULTI_EVALUE) {}
     MultiEValue(EValuePtr pv)
@@ -33,7 +33,7 @@ struct MultiEValue : public Object {
         values.push_back(pv);
     }
     MultiEValue(llvm::ArrayRef<EValuePtr> values)
-        : Object(MULTI_EVALUE), values(values) {}
+        : Object(MULTI_EVALUE), values(values.begin(), values.end()) {}
     size_t size() { return values.size(); }
     void add(EValuePtr x) { values.push_back(x); }
     void add(MultiEValuePtr x) {
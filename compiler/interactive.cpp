@@ -187,6 +187,14 @@ namespace clay {
         addGlobals(module, toplevels);
     }
 
+    static void discardFunction(llvm::Function *f)
+    {
+        if (!f->use_empty())
+            return;
+        engine->freeMachineCodeForFunction(f);
+        f->eraseFromParent();
+    }
+
     static void jitStatements(llvm::ArrayRef<StatementPtr> statements)
     {
         if (statements.empty()) {
@@ -228,10 +236,18 @@ namespace clay {
 
         engine->runFunction(ctor, std::vector<llvm::GenericValue>());
 
-        void* dtorLlvmFun = engine->getPointerToFunction(dtor);
-        typedef void (*PFN)();
-        atexit((PFN)(uintptr_t)dtorLlvmFun);
+        if (dtor != NULL) {
+            void* dtorLlvmFun = engine->getPointerToFunction(dtor);
+            typedef void (*PFN)();
+            atexit((PFN)(uintptr_t)dtorLlvmFun);
+        }
         engine->runFunction(entryProc->llvmFunc, std::vector<llvm::GenericValue>());
+
+        // nothing can refer to this input's constructor or statements
+        // again, so drop them rather than let the module grow with them
+        discardFunction(ctor);
+        discardFunction(entryProc->llvmFunc);
+        entryProc->llvmFunc = NULL;
     }
 
     static void jitAndPrintExpr(ExprPtr expr) {
@@ -304,6 +320,9 @@ namespace clay {
         targetOptions.JITExceptionHandling = true;
         eb.setTargetOptions(targetOptions);
         engine = eb.create();
+        // compile procedures on their first call rather than everything
+        // reachable from each input up front
+        engine->DisableLazyCompilation(false);
         engine->runStaticConstructorsDestructors(false);
 
         setAddTokens(&addTokens);
@@ -61,7 +61,7 @@ const OverloadPtr callableInterface(ObjectPtr x)
     }
 }
 
-static llvm::ArrayRef<OverloadPtr> callableOverloads(ObjectPtr x)
+static const vector<OverloadPtr> &callableOverloads(ObjectPtr x)
 {
     initCallable(x);
     switch (x->objKind) {
@@ -162,8 +162,8 @@ InvokeSet* lookupInvokeSet(ObjectPtr callable,
         }
     }
     OverloadPtr interface = callableInterface(callable);
-    llvm::ArrayRef<OverloadPtr> overloads = callableOverloads(callable);
-    InvokeSet* invokeSet = new InvokeSet(callable, argsKey, interface, overloads);
+    InvokeSet* invokeSet = new InvokeSet(callable, argsKey, interface,
+                                         callableOverloads(callable));
     invokeSet->shouldLog = shouldLogCallable(callable);
 
     bucket.push_back(invokeSet);
@@ -184,21 +184,27 @@ vector<InvokeSet*> lookupInvokeSets(ObjectPtr callable) {
     return r;
 }
 
+vector<InvokeSet*> allInvokeSets() {
+    vector<InvokeSet*> r;
+    for (unsigned i = 0; i < invokeTable.size(); ++i)
+        r.insert(r.end(), invokeTable[i].begin(), invokeTable[i].end());
+    return r;
+}
+
 
 //
 // lookupInvokeEntry
 //
 
 static
-MatchSuccessPtr findMatchingInvoke(llvm::ArrayRef<OverloadPtr> overloads,
+MatchSuccessPtr findMatchingInvoke(InvokeSet *invokeSet,
                                    unsigned &overloadIndex,
-                                   ObjectPtr callable,
-                                   llvm::ArrayRef<TypePtr> argsKey,
+                                   unsigned overloadEnd,
                                    MatchFailureError &failures)
 {
-    while (overloadIndex < overloads.size()) {
-        OverloadPtr x = overloads[overloadIndex++];
-        MatchResultPtr result = matchInvoke(x, callable, argsKey);
+    while (overloadIndex < overloadEnd) {
+        OverloadPtr x = invokeSet->overload(overloadIndex++);
+        MatchResultPtr result = matchInvoke(x, invokeSet->callable, invokeSet->argsKey);
         failures.failures.push_back(make_pair(x, result));
         if (result->matchCode == MATCH_SUCCESS) {
             MatchSuccess *y = (MatchSuccess *)result.ptr();
@@ -217,10 +223,9 @@ static MatchSuccessPtr getMatch(InvokeSet* invokeSet,
     assert(entryIndex == invokeSet->matches.size());
 
     unsigned nextOverloadIndex = invokeSet->nextOverloadIndex;
-    MatchSuccessPtr match = findMatchingInvoke(invokeSet->overloads,
+    MatchSuccessPtr match = findMatchingInvoke(invokeSet,
                                                nextOverloadIndex,
-                                               invokeSet->callable,
-                                               invokeSet->argsKey,
+                                               invokeSet->overloadCount(),
                                                failures);
     if (!match)
         return NULL;
@@ -262,9 +267,9 @@ static ValueTempness tempnessKeyItem(ValueTempness formalTempness,
 }
 
 static bool matchTempness(CodePtr code,
-                          const vector<bool>& argsRValues,
+                          const TempnessKey &argsRValues,
                           bool callByName,
-                          vector<ValueTempness> &tempnessKey,
+                          TempnessKey &tempnessKey,
                           vector<uint8_t> &forwardedRValueFlags)
 {
     llvm::ArrayRef<FormalArgPtr> fargs = code->formalArgs;
@@ -349,11 +354,8 @@ InvokeEntry* lookupInvokeEntry(ObjectPtr callable,
                                llvm::ArrayRef<PVData> args,
                                MatchFailureError &failures)
 {
-    vector<TypePtr> argTypes;
-    vector<bool> argRValues;
-
-    argTypes.reserve(args.size());
-    argRValues.reserve(args.size());
+    llvm::SmallVector<TypePtr, 8> argTypes;
+    TempnessKey argRValues;
 
     for (llvm::ArrayRef<PVData>::const_iterator arg = args.begin(); arg != args.end(); ++arg) {
         argTypes.push_back(arg->type);
@@ -370,10 +372,8 @@ InvokeEntry* lookupInvokeEntry(ObjectPtr callable,
     invokeSet->evaluatingPredicate = true;
     FinallyClearEvaluatingPredicate FinallyClearEvaluatingPredicate(invokeSet);
 
-    map<vector<bool>, InvokeEntry*>::iterator iter1 =
-        invokeSet->tempnessMap.find(argRValues);
-    if (iter1 != invokeSet->tempnessMap.end())
-        return iter1->second;
+    if (InvokeEntry *cached = invokeSet->tempnessMap.lookup(argRValues))
+        return cached;
     
     MatchResultPtr interfaceResult;
     if (invokeSet->interface != NULL) {
@@ -388,7 +388,7 @@ InvokeEntry* lookupInvokeEntry(ObjectPtr callable,
     }
 
     MatchSuccessPtr match;
-    vector<ValueTempness> tempnessKey;
+    TempnessKey tempnessKey;
     vector<uint8_t> forwardedRValueFlags;
     
     unsigned i = 0;
@@ -408,29 +408,26 @@ InvokeEntry* lookupInvokeEntry(ObjectPtr callable,
     if (!match)
         return NULL;
 
-    map<vector<ValueTempness>, InvokeEntry*>::iterator iter2 =
-            invokeSet->tempnessMap2.find(tempnessKey);
-    if (iter2 != invokeSet->tempnessMap2.end()) {
-        invokeSet->tempnessMap[argRValues] = iter2->second;
-        return iter2->second;
+    if (InvokeEntry *existing = invokeSet->tempnessMap2.lookup(tempnessKey)) {
+        invokeSet->tempnessMap.insert(argRValues, existing);
+        return existing;
     }
 
     InvokeEntry* entry = newInvokeEntry(invokeSet, match,
         (MatchSuccess*)interfaceResult.ptr());
     entry->forwardedRValueFlags = forwardedRValueFlags;
     
-    invokeSet->tempnessMap2[tempnessKey] = entry;
-    invokeSet->tempnessMap[argRValues] = entry;
+    invokeSet->tempnessMap2.insert(tempnessKey, entry);
+    invokeSet->tempnessMap.insert(argRValues, entry);
 
     if (_finalOverloadsEnabled) {
         MatchSuccessPtr match2;
-        vector<ValueTempness> tempnessKey2;
+        TempnessKey tempnessKey2;
         vector<uint8_t> forwardedRValueFlags2;
         unsigned j = invokeSet->nextOverloadIndex;
-        while ((match2 = findMatchingInvoke(callableOverloads(callable),
+        while ((match2 = findMatchingInvoke(invokeSet,
                                            j,
-                                           callable,
-                                           argTypes,
+                                           invokeSet->symbolOverloadCount,
                                            failures)).ptr() != NULL) {
             if (matchTempness(match2->overload->code,
                               argRValues,
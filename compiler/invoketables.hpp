@@ -34,6 +34,7 @@ struct InvokeEntry {
     unsigned varArgPosition;
 
     InlineAttribute isInline;
+    int autoInlineSize;
 
     ObjectPtr analysis;
     vector<uint8_t> returnIsRef;
@@ -48,6 +49,8 @@ struct InvokeEntry {
     bool analyzing:1;
     bool callByName:1; // if callByName the rest of InvokeEntry is not set
     bool runtimeNop:1;
+    bool autoInlineChecked:1;
+    bool autoInline:1;
 
     InvokeEntry(InvokeSet *parent,
                 ObjectPtr callable,
@@ -56,12 +59,15 @@ struct InvokeEntry {
           argsKey(argsKey),
           varArgPosition(0),
           isInline(IGNORE),
+          autoInlineSize(0),
           llvmFunc(NULL),
           debugInfo(NULL),
           analyzed(false),
           analyzing(false),
           callByName(false),
-          runtimeNop(false)
+          runtimeNop(false),
+          autoInlineChecked(false),
+          autoInline(false)
     {
         for (size_t i = 0; i < CC_Count; ++i)
             llvmCWrappers[i] = NULL;
@@ -75,15 +81,70 @@ struct InvokeEntry {
 
 extern vector<OverloadPtr> patternOverloads;
 
+// the tempness of each argument of a call, two bits per argument, either
+// 0/1 for lvalue/rvalue arguments or a ValueTempness. a set only looks up
+// keys of its own argument count, so there is no heap allocation for calls
+// of up to 32 arguments.
+struct TempnessKey {
+    llvm::SmallVector<uint64_t, 1> words;
+    unsigned length;
+
+    TempnessKey() : length(0) {}
+    void push_back(unsigned x) {
+        assert(x < 4);
+        if (length % 32 == 0)
+            words.push_back(0);
+        words.back() |= uint64_t(x) << (2 * (length % 32));
+        ++length;
+    }
+    unsigned operator[](unsigned i) const {
+        assert(i < length);
+        return unsigned(words[i / 32] >> (2 * (i % 32))) & 3;
+    }
+    unsigned size() const { return length; }
+    bool empty() const { return length == 0; }
+    void clear() { words.clear(); length = 0; }
+    bool operator==(const TempnessKey &other) const {
+        return length == other.length && words == other.words;
+    }
+};
+
+// nearly every set is invoked with only one or two tempness combinations,
+// so entries are found by a linear scan of an inline array
+struct TempnessTable {
+    llvm::SmallVector<pair<TempnessKey, InvokeEntry*>, 2> entries;
+
+    InvokeEntry *lookup(const TempnessKey &key) const {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].first == key)
+                return entries[i].second;
+        }
+        return NULL;
+    }
+    void insert(const TempnessKey &key, InvokeEntry *entry) {
+        assert(lookup(key) == NULL);
+        entries.push_back(make_pair(key, entry));
+    }
+};
+
 struct InvokeSet {
     ObjectPtr callable;
     vector<TypePtr> argsKey;
     OverloadPtr interface;
-    vector<OverloadPtr> overloads;
+
+    // the set sees the callable's overloads followed by the pattern
+    // overloads, as they were when it was created. both vectors are shared
+    // with every other set; since overloads are only ever added at their
+    // front, the set's view of each is its last `count` elements.
+    const vector<OverloadPtr> *symbolOverloads;
+    unsigned symbolOverloadCount;
+    unsigned patternOverloadCount;
 
     vector<MatchSuccessPtr> matches;
-    map<vector<bool>, InvokeEntry*> tempnessMap;
-    map<vector<ValueTempness>, InvokeEntry*> tempnessMap2;
+    // entries by the rvalue-ness of the arguments, and by the tempness
+    // actually required by the matched overload
+    TempnessTable tempnessMap;
+    TempnessTable tempnessMap2;
 
     unsigned nextOverloadIndex; //:31;
 
@@ -93,14 +154,25 @@ struct InvokeSet {
     InvokeSet(ObjectPtr callable,
               llvm::ArrayRef<TypePtr> argsKey,
               OverloadPtr symbolInterface,
-              llvm::ArrayRef<OverloadPtr> symbolOverloads)
+              const vector<OverloadPtr> &symbolOverloads)
         : callable(callable), argsKey(argsKey),
           interface(symbolInterface),
-          overloads(symbolOverloads), nextOverloadIndex(0),
+          symbolOverloads(&symbolOverloads),
+          symbolOverloadCount(unsigned(symbolOverloads.size())),
+          patternOverloadCount(unsigned(patternOverloads.size())),
+          nextOverloadIndex(0),
           shouldLog(false),
           evaluatingPredicate(false)
-    {
-        overloads.insert(overloads.end(), patternOverloads.begin(), patternOverloads.end());
+    {}
+    unsigned overloadCount() const {
+        return symbolOverloadCount + patternOverloadCount;
+    }
+    const OverloadPtr &overload(unsigned i) const {
+        assert(symbolOverloads->size() >= symbolOverloadCount);
+        assert(patternOverloads.size() >= patternOverloadCount);
+        if (i < symbolOverloadCount)
+            return (*symbolOverloads)[symbolOverloads->size() - symbolOverloadCount + i];
+        return patternOverloads[patternOverloads.size() - overloadCount() + i];
     }
     void *operator new(size_t num_bytes) {
         return invokeSetAllocator->Allocate();
@@ -121,6 +193,7 @@ struct MatchFailureError {
 InvokeSet *lookupInvokeSet(ObjectPtr callable,
                            llvm::ArrayRef<TypePtr> argsKey);
 vector<InvokeSet*> lookupInvokeSets(ObjectPtr callable);
+vector<InvokeSet*> allInvokeSets();
 InvokeEntry* lookupInvokeEntry(ObjectPtr callable,
                                llvm::ArrayRef<PVData> args,
                                MatchFailureError &failures);
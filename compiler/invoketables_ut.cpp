@@ -0,0 +1,96 @@
+#include "invoketables.hpp"
+#include "hirestimer.hpp"
+
+#include "ut.hpp"
+
+
+namespace clay {
+
+CLAY_UNITTEST(TempnessKey_packing) {
+    TempnessKey key;
+    for (unsigned i = 0; i < 70; ++i)
+        key.push_back(i % 4);
+    UT_ASSERT(key.size() == 70);
+    UT_ASSERT(key.words.size() == 3);
+    for (unsigned i = 0; i < 70; ++i)
+        UT_ASSERT(key[i] == i % 4);
+
+    TempnessKey shorter;
+    for (unsigned i = 0; i < 69; ++i)
+        shorter.push_back(i % 4);
+    UT_ASSERT(!(key == shorter));
+    shorter.push_back(69 % 4);
+    UT_ASSERT(key == shorter);
+
+    key.clear();
+    UT_ASSERT(key.empty());
+    UT_ASSERT(key.words.empty());
+}
+
+CLAY_UNITTEST(TempnessTable_lookup) {
+    InvokeEntry *a = (InvokeEntry *)0x10;
+    InvokeEntry *b = (InvokeEntry *)0x20;
+
+    TempnessKey lvalue, rvalue, dontcare;
+    lvalue.push_back(TEMPNESS_LVALUE);
+    rvalue.push_back(TEMPNESS_RVALUE);
+    dontcare.push_back(TEMPNESS_DONTCARE);
+
+    TempnessTable table;
+    UT_ASSERT(table.lookup(lvalue) == NULL);
+    table.insert(lvalue, a);
+    table.insert(rvalue, b);
+    UT_ASSERT(table.lookup(lvalue) == a);
+    UT_ASSERT(table.lookup(rvalue) == b);
+    UT_ASSERT(table.lookup(dontcare) == NULL);
+}
+
+// the cache hit path of lookupInvokeEntry: build the key of a call with
+// three arguments and find it among the two entries of its set, with the
+// old map<vector<bool>> and with TempnessTable
+CLAY_UNITTEST(TempnessTable_benchmark) {
+    const unsigned iterations = 1000000;
+    InvokeEntry *a = (InvokeEntry *)0x10;
+    InvokeEntry *b = (InvokeEntry *)0x20;
+    size_t found = 0;
+
+    map<vector<bool>, InvokeEntry*> oldTable;
+    vector<bool> oldKey;
+    oldKey.push_back(false); oldKey.push_back(true); oldKey.push_back(false);
+    oldTable[oldKey] = a;
+    oldKey[1] = false;
+    oldTable[oldKey] = b;
+
+    HiResTimer oldTimer;
+    oldTimer.start();
+    for (unsigned i = 0; i < iterations; ++i) {
+        vector<bool> key;
+        key.reserve(3);
+        key.push_back(false); key.push_back((i & 1) != 0); key.push_back(false);
+        found += oldTable.find(key) != oldTable.end();
+    }
+    oldTimer.stop();
+
+    TempnessTable newTable;
+    TempnessKey newKey;
+    newKey.push_back(0); newKey.push_back(1); newKey.push_back(0);
+    newTable.insert(newKey, a);
+    newKey.clear();
+    newKey.push_back(0); newKey.push_back(0); newKey.push_back(0);
+    newTable.insert(newKey, b);
+
+    HiResTimer newTimer;
+    newTimer.start();
+    for (unsigned i = 0; i < iterations; ++i) {
+        TempnessKey key;
+        key.push_back(0); key.push_back(i & 1); key.push_back(0);
+        found += newTable.lookup(key) != NULL;
+    }
+    newTimer.stop();
+
+    UT_ASSERT(found == 2 * iterations);
+    printf("    map<vector<bool>>: %.2f ms, TempnessTable: %.2f ms\n",
+           oldTimer.elapsedMillis(), newTimer.elapsedMillis());
+}
+
+}
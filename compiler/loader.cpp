@@ -10,6 +10,10 @@
 #include "env.hpp"
 #include "error.hpp"
 
+#include <algorithm>
+
+#include <llvm/ADT/StringSet.h>
+
 
 #pragma clang diagnostic ignored "-Wcovered-switch-default"
 
@@ -21,6 +25,10 @@ using namespace std;
 static vector<PathString> searchPath;
 static vector<llvm::SmallString<32> > moduleSuffixes;
 
+// procedure bodies of modules loaded by name are only parsed when used,
+// so that the bulk of the prelude is tokenized but never parsed
+static bool deferredParsing = true;
+
 llvm::StringMap<ModulePtr> globalModules;
 llvm::StringMap<string> globalFlags;
 ModulePtr globalMainModule;
@@ -114,6 +122,7 @@ static llvm::StringRef getPtrSize(const llvm::DataLayout *dataLayout) {
 }
 
 static void initModuleSuffixes() {
+    moduleSuffixes.clear();
     llvm::Triple triple(llvmModule->getTargetTriple());
 
     llvm::StringRef os = getOS(triple);
@@ -149,6 +158,10 @@ void initLoader() {
     initModuleSuffixes();
 }
 
+void setDeferredParsing(bool enabled) {
+    deferredParsing = enabled;
+}
+
 
 //
 // toKey
@@ -171,25 +184,163 @@ static string toKey(DottedNamePtr name) {
 // locateModule
 //
 
+//
+// rather than probing the filesystem for every suffix in every search path
+// entry, each directory is listed once and the probes are answered from
+// the listing. a search path entry containing a MODULE_INDEX_NAME file,
+// written by writeModuleIndex, names every module file below it, and its
+// directories are not listed while they are no newer than the index. a
+// directory the index does not know of, or one changed since the index was
+// written, is listed as usual. a module that no listing has, for instance
+// one imported with a different case on a case-insensitive filesystem, is
+// looked for by probing the filesystem as a last resort.
+//
+
+static const char MODULE_INDEX_NAME[] = "clay-modules.index";
+
+static llvm::StringMap<llvm::StringSet<> > directoryListings;
+static llvm::StringMap<llvm::StringSet<> > indexListings;
+static vector<bool> searchPathIndexed;
+static vector<bool> searchPathIndexLoaded;
+static vector<llvm::sys::TimeValue> searchPathIndexTimes;
+
 void setSearchPath(llvm::ArrayRef<PathString>  path) {
     searchPath = path;
+    directoryListings.clear();
+    indexListings.clear();
+    searchPathIndexed.assign(searchPath.size(), false);
+    searchPathIndexLoaded.assign(searchPath.size(), false);
+    searchPathIndexTimes.assign(searchPath.size(), llvm::sys::TimeValue());
+}
+
+static bool modificationTime(llvm::StringRef path, llvm::sys::TimeValue &time) {
+    llvm::sys::PathWithStatus pathWithStatus(path);
+    const llvm::sys::FileStatus *status = pathWithStatus.getFileStatus();
+    if (status == NULL)
+        return false;
+    time = status->getTimestamp();
+    return true;
+}
+
+static void loadModuleIndex(size_t i) {
+    searchPathIndexLoaded[i] = true;
+
+    PathString indexPath(searchPath[i]);
+    llvm::sys::path::append(indexPath, MODULE_INDEX_NAME);
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    if (llvm::MemoryBuffer::getFile(indexPath.str(), buffer))
+        return;
+    if (!modificationTime(indexPath, searchPathIndexTimes[i]))
+        return;
+    searchPathIndexed[i] = true;
+
+    llvm::SmallVector<llvm::StringRef, 256> lines;
+    buffer->getBuffer().split(lines, "\n", -1, false);
+    for (size_t j = 0; j < lines.size(); ++j) {
+        // one '/' separated path per line, relative to the search path entry
+        PathString dir(searchPath[i]);
+        llvm::StringRef rest = lines[j].rtrim();
+        while (true) {
+            std::pair<llvm::StringRef, llvm::StringRef> part = rest.split('/');
+            if (part.second.empty()) {
+                indexListings[dir.str()].insert(part.first);
+                break;
+            }
+            llvm::sys::path::append(dir, part.first);
+            rest = part.second;
+        }
+    }
+}
+
+static const llvm::StringSet<> &directoryListing(llvm::StringRef dir, size_t entry) {
+    llvm::StringMap<llvm::StringSet<> >::iterator found = directoryListings.find(dir);
+    if (found != directoryListings.end())
+        return found->second;
+
+    llvm::StringSet<> &listing = directoryListings[dir];
+    if (searchPathIndexed[entry]) {
+        llvm::StringMap<llvm::StringSet<> >::iterator indexed = indexListings.find(dir);
+        llvm::sys::TimeValue modified;
+        // mtimes may only have a resolution of seconds, so a file added
+        // within the second the index was written can still be missed
+        if (indexed != indexListings.end()
+            && modificationTime(dir, modified)
+            && modified <= searchPathIndexTimes[entry])
+        {
+            llvm::StringSet<>::const_iterator i, end;
+            for (i = indexed->second.begin(), end = indexed->second.end(); i != end; ++i)
+                listing.insert(i->getKey());
+            return listing;
+        }
+    }
+    llvm::error_code ec;
+    for (llvm::sys::fs::directory_iterator i(dir, ec), end; !ec && i != end; i.increment(ec))
+        listing.insert(llvm::sys::path::filename(i->path()));
+    return listing;
 }
 
-static bool locateFile(llvm::StringRef relativePath, PathString &path) {
+static bool locateFile(llvm::StringRef relativePath, PathString &path, bool probe) {
     // relativePath has no suffix
     for (size_t i = 0; i < searchPath.size(); ++i) {
+        if (!searchPathIndexLoaded[i])
+            loadModuleIndex(i);
         PathString pathWOSuffix(searchPath[i]);
         llvm::sys::path::append(pathWOSuffix, relativePath);
+        const llvm::StringSet<> *listing = NULL;
+        if (!probe)
+            listing = &directoryListing(
+                llvm::sys::path::parent_path(pathWOSuffix), i);
+        llvm::StringRef stem = llvm::sys::path::filename(pathWOSuffix);
         for (size_t j = 0; j < moduleSuffixes.size(); ++j) {
             path = pathWOSuffix;
             path.append(moduleSuffixes[j].begin(), moduleSuffixes[j].end());
-            if (llvm::sys::fs::exists(path.str()))
+            if (probe ? llvm::sys::fs::exists(path.str())
+                      : listing->count((stem + moduleSuffixes[j]).str()) != 0)
                 return true;
         }
     }
     return false;
 }
 
+bool writeModuleIndex(llvm::StringRef root, string &errorMessage) {
+    vector<string> files;
+    llvm::error_code ec;
+    for (llvm::sys::fs::recursive_directory_iterator i(root, ec), end;
+         !ec && i != end; i.increment(ec))
+    {
+        llvm::StringRef name = i->path();
+        if (!name.endswith(".clay"))
+            continue;
+        string relativePath;
+        llvm::StringRef relative = name.substr(root.size());
+        for (llvm::sys::path::const_iterator part = llvm::sys::path::begin(relative),
+                 partEnd = llvm::sys::path::end(relative);
+             part != partEnd; ++part)
+        {
+            if (*part == "/" || *part == "\\")
+                continue;
+            if (!relativePath.empty())
+                relativePath.push_back('/');
+            relativePath.append(part->begin(), part->end());
+        }
+        files.push_back(relativePath);
+    }
+    if (ec) {
+        errorMessage = root.str() + ": " + ec.message();
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+
+    PathString indexPath(root);
+    llvm::sys::path::append(indexPath, MODULE_INDEX_NAME);
+    llvm::raw_fd_ostream out(indexPath.c_str(), errorMessage);
+    if (!errorMessage.empty())
+        return false;
+    for (size_t i = 0; i < files.size(); ++i)
+        out << files[i] << '\n';
+    return true;
+}
+
 template<typename Iterator>
 static PathString toRelativePathUpto(DottedNamePtr name, Iterator limit) {
     PathString relativePath;
@@ -210,16 +361,37 @@ static PathString toRelativePath2(DottedNamePtr name) {
     return toRelativePathUpto(name, name->parts.end() - 1);
 }
 
+static bool findModule(DottedNamePtr name, PathString &path) {
+    PathString relativePath1 = toRelativePath1(name);
+    PathString relativePath2 = toRelativePath2(name);
+    return locateFile(relativePath1, path, false)
+        || locateFile(relativePath2, path, false)
+        || locateFile(relativePath1, path, true)
+        || locateFile(relativePath2, path, true);
+}
+
+bool locateModuleFile(llvm::StringRef moduleName, string &path) {
+    if (moduleSuffixes.empty())
+        initModuleSuffixes();
+    DottedNamePtr name = new DottedName();
+    llvm::SmallVector<llvm::StringRef, 4> parts;
+    moduleName.split(parts, ".");
+    for (size_t i = 0; i < parts.size(); ++i)
+        name->parts.push_back(Identifier::get(parts[i]));
+    PathString found;
+    if (!findModule(name, found))
+        return false;
+    path = found.str();
+    return true;
+}
+
 static PathString locateModule(DottedNamePtr name) {
     PathString path;
-
-    PathString relativePath1 = toRelativePath1(name);
-    if (locateFile(relativePath1, path))
+    if (findModule(name, path))
         return path;
 
+    PathString relativePath1 = toRelativePath1(name);
     PathString relativePath2 = toRelativePath2(name);
-    if (locateFile(relativePath2, path))
-        return path;
 
     string s;
     llvm::raw_string_ostream ss(s);
@@ -343,7 +515,8 @@ static ModulePtr loadModuleByName(DottedNamePtr name, vector<string> *sourceFile
         if (verbose) {
             llvm::errs() << "loading module " << name->join() << " from " << path << "\n";
         }
-        module = parse(key, loadFile(path, sourceFiles));
+        module = parse(key, loadFile(path, sourceFiles),
+            deferredParsing ? ParserDeferBodies : NoParserFlags);
     }
 
     globalModules[key] = module;
@@ -442,7 +615,7 @@ ModulePtr loadProgram(llvm::StringRef fileName, vector<string> *sourceFiles, boo
     return globalMainModule;
 }
 
-ModulePtr loadProgramSource(llvm::StringRef name, llvm::StringRef source, bool verbose, bool repl) {
+ModulePtr loadProgramSource(llvm::StringRef name, llvm::StringRef source, vector<string> *sourceFiles, bool verbose, bool repl) {
     SourcePtr mainSource = new Source(name,
         llvm::MemoryBuffer::getMemBufferCopy(source));
     if (llvmDIBuilder != NULL) {
@@ -452,9 +625,10 @@ ModulePtr loadProgramSource(llvm::StringRef name, llvm::StringRef source, bool v
     }
 
     globalMainModule = parse("", mainSource);
-    // Don't keep track of source files for -e script
-    ModulePtr prelude = loadPrelude(NULL, verbose, repl);
-    loadDependents(globalMainModule, NULL, verbose);
+    // the -e script itself is not a file, only the modules it loads are
+    // tracked
+    ModulePtr prelude = loadPrelude(sourceFiles, verbose, repl);
+    loadDependents(globalMainModule, sourceFiles, verbose);
     installGlobals(globalMainModule);
     initModule(prelude);
     initModule(globalMainModule);
@@ -556,6 +730,8 @@ static string toString(const T& t) {
     return s;
 }
 
+// overloads are only ever added at the front: InvokeSets share these
+// vectors and rely on the overloads they have already seen staying at the end
 void addOverload(vector<OverloadPtr> &overloads, OverloadPtr &x) {
     overloads.insert(overloads.begin(), x);
     if (x->hasAsConversion)
@@ -1093,6 +1269,7 @@ static ModulePtr makePrimitivesModule() {
     PRIMITIVE(AttributeLLVMCall);
     PRIMITIVE(AttributeDLLImport);
     PRIMITIVE(AttributeDLLExport);
+    PRIMITIVE(AttributeMultiversion);
 
     PRIMITIVE(ExternalCodePointer);
     PRIMITIVE(makeExternalCodePointer);
@@ -1248,6 +1425,9 @@ static ModulePtr makeOperatorsModule() {
     OPERATOR(nextValue);
     OPERATOR(hasValueP);
     OPERATOR(getValue);
+    OPERATOR(countedIterationP);
+    OPERATOR(countedIterationBounds);
+    OPERATOR(cpuHasFeatureP);
     OPERATOR(throwValue);
     OPERATOR(exceptionIsP);
     OPERATOR(exceptionAs);
@@ -1367,6 +1547,8 @@ static ObjectPtr convertObject(ObjectPtr x) {
 
 DEFINE_PRIMITIVE_ACCESSOR(addressOf)
 DEFINE_PRIMITIVE_ACCESSOR(boolNot)
+DEFINE_PRIMITIVE_ACCESSOR(integerLesserP)
+DEFINE_PRIMITIVE_ACCESSOR(numericAdd)
 DEFINE_PRIMITIVE_ACCESSOR(Pointer)
 DEFINE_PRIMITIVE_ACCESSOR(CodePointer)
 DEFINE_PRIMITIVE_ACCESSOR(ExternalCodePointer)
@@ -1428,6 +1610,9 @@ DEFINE_OPERATOR_ACCESSOR(iterator)
 DEFINE_OPERATOR_ACCESSOR(nextValue)
 DEFINE_OPERATOR_ACCESSOR(hasValueP)
 DEFINE_OPERATOR_ACCESSOR(getValue)
+DEFINE_OPERATOR_ACCESSOR(countedIterationP)
+DEFINE_OPERATOR_ACCESSOR(countedIterationBounds)
+DEFINE_OPERATOR_ACCESSOR(cpuHasFeatureP)
 DEFINE_OPERATOR_ACCESSOR(throwValue)
 DEFINE_OPERATOR_ACCESSOR(exceptionIsP)
 DEFINE_OPERATOR_ACCESSOR(exceptionAs)
@@ -16,9 +16,14 @@ void getProcedureMonoTypes(ProcedureMono &mono, EnvPtr env,
     llvm::ArrayRef<FormalArgPtr> formalArgs, bool hasVarArg);
 
 void initLoader();
+void setDeferredParsing(bool enabled);
 void setSearchPath(const llvm::ArrayRef<PathString> path);
+bool writeModuleIndex(llvm::StringRef root, string &errorMessage);
+// the file that the module would be loaded from with the current search
+// path; false if it would not be found
+bool locateModuleFile(llvm::StringRef moduleName, string &path);
 ModulePtr loadProgram(llvm::StringRef fileName, vector<string> *sourceFiles, bool verbose, bool repl);
-ModulePtr loadProgramSource(llvm::StringRef name, llvm::StringRef source, bool verbose, bool repl);
+ModulePtr loadProgramSource(llvm::StringRef name, llvm::StringRef source, vector<string> *sourceFiles, bool verbose, bool repl);
 ModulePtr loadedModule(llvm::StringRef module);
 ModulePtr preludeModule();
 ModulePtr primitivesModule();
@@ -117,6 +122,7 @@ enum PrimOpCode {
     PRIM_AttributeLLVMCall,
     PRIM_AttributeDLLImport,
     PRIM_AttributeDLLExport,
+    PRIM_AttributeMultiversion,
 
     PRIM_ExternalCodePointer,
     PRIM_makeExternalCodePointer,
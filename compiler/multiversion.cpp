@@ -0,0 +1,154 @@
+#include "clay.hpp"
+#include "multiversion.hpp"
+
+#include <llvm/Transforms/Utils/Cloning.h>
+
+namespace clay {
+
+
+vector<MultiversionedProcedure> multiversionedProcedures;
+vector<string> multiversionSharedGlobals;
+
+
+//
+// multiversionTargetFeatures
+//
+
+string multiversionTargetFeatures(llvm::StringRef featureSet)
+{
+    llvm::SmallVector<llvm::StringRef, 4> names;
+    featureSet.split(names, ",", -1, false);
+    string result;
+    for (size_t i = 0; i < names.size(); ++i) {
+        llvm::StringRef name = names[i].trim();
+        if (name.startswith("+"))
+            name = name.substr(1);
+        if (name.empty())
+            continue;
+        if (!result.empty())
+            result += ',';
+        result += '+';
+        for (size_t j = 0; j < name.size(); ++j) {
+            // sse4.1 and sse4.2 are sse41 and sse42 to llvm
+            if (name[j] != '.')
+                result += name[j];
+        }
+    }
+    return result;
+}
+
+
+//
+// splitMultiversionedProcedures
+//
+// each feature set's module starts as a copy of the whole program, in
+// which the versions take over their baseline bodies and everything else
+// becomes internal. constants and code that the versions use are
+// compiled again along with them, but mutable globals must stay shared
+// with the program module, so they become hidden externals there.
+//
+
+static void shareGlobal(llvm::Module *module, llvm::GlobalVariable *copy)
+{
+    llvm::GlobalVariable *original = module->getNamedGlobal(copy->getName());
+    assert(original != NULL);
+    if (original->hasLocalLinkage()) {
+        original->setName("clay.shared." + original->getName());
+        original->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        original->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        multiversionSharedGlobals.push_back(original->getName().str());
+    }
+    copy->setName(original->getName());
+    copy->setInitializer(NULL);
+    copy->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    copy->setVisibility(original->getVisibility());
+}
+
+static llvm::Module *splitFeatureSet(llvm::Module *module,
+                                     llvm::ArrayRef<pair<string, string> > versions)
+{
+    llvm::ValueToValueMapTy valueMap;
+    llvm::Module *split = llvm::CloneModule(module, valueMap);
+
+    set<llvm::Function*> kept;
+    for (size_t i = 0; i < versions.size(); ++i) {
+        llvm::Function *body = split->getFunction(versions[i].first);
+        llvm::Function *version = split->getFunction(versions[i].second);
+        assert(body != NULL && version != NULL);
+        version->replaceAllUsesWith(body);
+        body->takeName(version);
+        version->eraseFromParent();
+        body->setLinkage(llvm::GlobalValue::ExternalLinkage);
+        kept.insert(body);
+    }
+
+    llvm::Module::iterator fi, fend;
+    for (fi = split->begin(), fend = split->end(); fi != fend; ++fi) {
+        if (!fi->isDeclaration() && !kept.count(fi))
+            fi->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+
+    vector<llvm::GlobalVariable*> intrinsicGlobals;
+    llvm::Module::global_iterator gi, gend;
+    for (gi = split->global_begin(), gend = split->global_end(); gi != gend; ++gi) {
+        if (gi->getName().startswith("llvm."))
+            intrinsicGlobals.push_back(gi);
+        else if (!gi->isDeclaration())
+            gi->setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+    // the program module runs the constructors and destructors
+    for (size_t i = 0; i < intrinsicGlobals.size(); ++i)
+        intrinsicGlobals[i]->eraseFromParent();
+
+    llvm::PassManager passes;
+    passes.add(llvm::createStripSymbolsPass(true));
+    passes.add(llvm::createGlobalDCEPass());
+    passes.run(*split);
+
+    for (gi = split->global_begin(), gend = split->global_end(); gi != gend; ++gi) {
+        if (!gi->isDeclaration() && !gi->isConstant())
+            shareGlobal(module, gi);
+    }
+    return split;
+}
+
+void splitMultiversionedProcedures(llvm::Module *module,
+                                   vector<MultiversionModule> &out)
+{
+    map<string, vector<pair<string, string> > > featureSets;
+    for (size_t i = 0; i < multiversionedProcedures.size(); ++i) {
+        MultiversionedProcedure &x = multiversionedProcedures[i];
+        for (size_t j = 0; j < x.clones.size(); ++j)
+            featureSets[x.clones[j].features].push_back(
+                make_pair(x.baseline, x.clones[j].name));
+    }
+
+    map<string, vector<pair<string, string> > >::iterator i, end;
+    for (i = featureSets.begin(), end = featureSets.end(); i != end; ++i)
+        out.push_back(MultiversionModule(i->first,
+                                         splitFeatureSet(module, i->second)));
+    multiversionedProcedures.clear();
+}
+
+
+//
+// dropMultiversionedProcedures
+//
+
+void dropMultiversionedProcedures(llvm::Module *module)
+{
+    for (size_t i = 0; i < multiversionedProcedures.size(); ++i) {
+        MultiversionedProcedure &x = multiversionedProcedures[i];
+        llvm::Function *body = module->getFunction(x.baseline);
+        assert(body != NULL);
+        for (size_t j = 0; j < x.clones.size(); ++j) {
+            llvm::Function *version = module->getFunction(x.clones[j].name);
+            assert(version != NULL);
+            version->replaceAllUsesWith(body);
+            version->eraseFromParent();
+        }
+    }
+    multiversionedProcedures.clear();
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+
+#include "clay.hpp"
+
+namespace clay {
+
+
+//
+// multiversioned external procedures
+//
+// an `external (multiversion, "sse4.2", "avx2")` procedure is generated as
+// a baseline body, a declaration of one version per feature set, and a
+// dispatcher under the procedure's own name that calls through a pointer,
+// which clayglobals_init points at the last version the CPU supports.
+// LLVM has no per-function target features, so before the program module
+// is optimized, the versions of each feature set are split off into a
+// module of their own to be compiled by a TargetMachine with those
+// features.
+//
+
+struct MultiversionClone {
+    string features;   // -mattr style, e.g. "+sse42,+popcnt"
+    string name;       // the version's declaration in the program module
+};
+
+struct MultiversionedProcedure {
+    string baseline;   // the baseline body in the program module
+    vector<MultiversionClone> clones;
+};
+
+extern vector<MultiversionedProcedure> multiversionedProcedures;
+
+// globals of the program module that split off versions refer to, and
+// which therefore must not be internalized
+extern vector<string> multiversionSharedGlobals;
+
+struct MultiversionModule {
+    string features;
+    llvm::Module *module;
+
+    MultiversionModule(llvm::StringRef features, llvm::Module *module)
+        : features(features), module(module) {}
+};
+
+// "sse4.2, popcnt" -> "+sse42,+popcnt"
+string multiversionTargetFeatures(llvm::StringRef featureSet);
+
+// moves the versions of each feature set into a new module, leaving
+// `module` with their declarations
+void splitMultiversionedProcedures(llvm::Module *module,
+                                   vector<MultiversionModule> &out);
+
+// binds every version to its baseline body, for outputs that are not
+// linked into a binary by clay
+void dropMultiversionedProcedures(llvm::Module *module);
+
+}
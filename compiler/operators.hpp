@@ -5,6 +5,8 @@ namespace clay {
 
 ObjectPtr primitive_addressOf();
 ObjectPtr primitive_boolNot();
+ObjectPtr primitive_integerLesserP();
+ObjectPtr primitive_numericAdd();
 ObjectPtr primitive_Pointer();
 ObjectPtr primitive_CodePointer();
 ObjectPtr primitive_ExternalCodePointer();
@@ -24,6 +26,8 @@ ObjectPtr primitive_activeException();
 
 ExprPtr primitive_expr_addressOf();
 ExprPtr primitive_expr_boolNot();
+ExprPtr primitive_expr_integerLesserP();
+ExprPtr primitive_expr_numericAdd();
 ExprPtr primitive_expr_Pointer();
 ExprPtr primitive_expr_CodePointer();
 ExprPtr primitive_expr_ExternalCodePointer();
@@ -68,6 +72,9 @@ ObjectPtr operator_iterator();
 ObjectPtr operator_nextValue();
 ObjectPtr operator_hasValueP();
 ObjectPtr operator_getValue();
+ObjectPtr operator_countedIterationP();
+ObjectPtr operator_countedIterationBounds();
+ObjectPtr operator_cpuHasFeatureP();
 ObjectPtr operator_throwValue();
 ObjectPtr operator_exceptionIsP();
 ObjectPtr operator_exceptionAs();
@@ -125,6 +132,9 @@ ExprPtr operator_expr_iterator();
 ExprPtr operator_expr_nextValue();
 ExprPtr operator_expr_hasValueP();
 ExprPtr operator_expr_getValue();
+ExprPtr operator_expr_countedIterationP();
+ExprPtr operator_expr_countedIterationBounds();
+ExprPtr operator_expr_cpuHasFeatureP();
 ExprPtr operator_expr_throwValue();
 ExprPtr operator_expr_exceptionIsP();
 ExprPtr operator_expr_exceptionAs();
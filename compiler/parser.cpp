@@ -6,12 +6,13 @@
 
 namespace clay {
 
-map<llvm::StringRef, IdentifierPtr> Identifier::freeIdentifiers;
+llvm::StringMap<IdentifierPtr> Identifier::freeIdentifiers;
 
 static vector<Token> *tokens;
 static unsigned position;
 static unsigned maxPosition;
 static bool parserOptionKeepDocumentation = false;
+static bool parserOptionDeferBodies = false;
 
 static AddTokensCallback addTokens = NULL;
 
@@ -1975,6 +1976,36 @@ static bool optBody(StatementPtr &x) {
     return false;
 }
 
+// skip over a `{ ... }` procedure body, recording its extent so that
+// parseDeferredBody can parse it if the procedure is ever instantiated
+static bool deferredBody(CodePtr code) {
+    if (!parserOptionDeferBodies)
+        return false;
+    unsigned p = save();
+    Location location = currentLocation();
+    if (!symbol("{")) {
+        restore(p);
+        return false;
+    }
+    Token *t;
+    int depth = 1;
+    while (depth > 0) {
+        if (!next(t)) {
+            restore(p);
+            return false;
+        }
+        if (t->tokenKind == T_SYMBOL) {
+            if (t->str == "{")
+                ++depth;
+            else if (t->str == "}")
+                --depth;
+        }
+    }
+    code->deferredBody = location;
+    code->deferredBodyLength = t->location.offset + 1 - location.offset;
+    return true;
+}
+
 
 
 //
@@ -2526,9 +2557,9 @@ static bool procedureWithBody(vector<TopLevelItemPtr> &x, Module *module, unsign
     code->hasVarArg = hasVarArg;
     bool exprRetSpecs = false;
     code->returnSpecsDeclared = allReturnSpecsWithFlag(code->returnSpecs, code->varReturnSpec, exprRetSpecs);
-    if (!body(code->body)) return false;
+    if (!deferredBody(code) && !body(code->body)) return false;
     code->location = location;
-    if(exprRetSpecs && code->body->stmtKind == RETURN){
+    if(exprRetSpecs && code->body != NULL && code->body->stmtKind == RETURN){
         Return *x = (Return *)code->body.ptr();    
         if(x->isExprReturn)
             x->isReturnSpecs = true;
@@ -2590,12 +2621,12 @@ static bool overload(TopLevelItemPtr &x, Module *module, unsigned s) {
     bool exprRetSpecs = false;
     code->returnSpecsDeclared = allReturnSpecsWithFlag(code->returnSpecs, code->varReturnSpec, exprRetSpecs);
     unsigned p = save();
-    if (!optBody(code->body)) {
+    if (!deferredBody(code) && !optBody(code->body)) {
         restore(p);
         if (callByName) return false;
         if (!llvmCode(code->llvmBody)) return false;
     }
-    if(exprRetSpecs && code->body->stmtKind == RETURN){
+    if(exprRetSpecs && code->body != NULL && code->body->stmtKind == RETURN){
         Return *x = (Return *)code->body.ptr();    
         if(x->isExprReturn)
             x->isReturnSpecs = true;
@@ -3289,7 +3320,7 @@ void applyParser(SourcePtr source, unsigned offset, size_t length, Parser parser
     if (!parser(node, parserParam) || (position < t.size())) {
         Location location;
         if (maxPosition == t.size())
-            location = Location(source.ptr(), unsigned(source->size()));
+            location = Location(source.ptr(), unsigned(offset + length));
         else
             location = t[maxPosition].location;
         pushLocation(location);
@@ -3306,15 +3337,37 @@ struct ModuleParser {
 };
 
 ModulePtr parse(llvm::StringRef moduleName, SourcePtr source, ParserFlags flags) {
-    if (flags && ParserKeepDocumentation)
+    if (flags & ParserKeepDocumentation)
         parserOptionKeepDocumentation = true;
+    parserOptionDeferBodies = (flags & ParserDeferBodies) != 0;
     ModulePtr m;
     ModuleParser p = { moduleName };
     applyParser(source, 0, source->size(), p, m.ptr(), m);
+    parserOptionDeferBodies = false;
     m->source = source;
     return m;
 }
 
+
+//
+// parseDeferredBody
+//
+
+static bool codeBody(StatementPtr &x, bool) {
+    return block(x);
+}
+
+void parseDeferredBody(CodePtr code) {
+    if (!code->deferredBody.ok())
+        return;
+    StatementPtr body;
+    applyParser(code->deferredBody.source, code->deferredBody.offset,
+                code->deferredBodyLength, codeBody, false, body);
+    code->body = body;
+    code->deferredBody = Location();
+    code->deferredBodyLength = 0;
+}
+
 
 //
 // parseExpr
@@ -9,7 +9,8 @@ namespace clay {
 enum ParserFlags
 {
     NoParserFlags = 0,
-    ParserKeepDocumentation = 1
+    ParserKeepDocumentation = 1,
+    ParserDeferBodies = 2
 };
 
 struct ReplItem {
@@ -28,6 +29,7 @@ void parseStatements(SourcePtr source, unsigned offset, size_t length,
 void parseTopLevelItems(SourcePtr source, unsigned offset, size_t length,
     vector<TopLevelItemPtr> &topLevels, Module *);
 ReplItem parseInteractive(SourcePtr source, unsigned offset, size_t length);
+void parseDeferredBody(CodePtr code);
 
 typedef vector<Token>(*AddTokensCallback)();
 void setAddTokens(AddTokensCallback f);
@@ -0,0 +1,403 @@
+#include "clay.hpp"
+#include "codegen.hpp"
+#include "pgo.hpp"
+#include "invoketables.hpp"
+
+#include <llvm/MDBuilder.h>
+
+namespace clay {
+
+
+//
+// profile generation
+//
+
+static bool generateEnabled = false;
+static string generateOutputFile;
+
+static bool useEnabled = false;
+static llvm::StringMap<uint64_t> profileCounts;
+// the highest entry count of any procedure
+static uint64_t maxEntryCount = 0;
+
+struct ProfileCounter {
+    string key;
+    llvm::Constant *counter;
+    // the global holding the counter, which code updating it refers to
+    llvm::GlobalVariable *global;
+    ProfileCounter(llvm::StringRef key, llvm::Constant *counter,
+                   llvm::GlobalVariable *global)
+        : key(key), counter(counter), global(global) {}
+};
+
+static vector<ProfileCounter> profileCounters;
+static llvm::Function *profileWriter = NULL;
+
+// number of conditional branches and dispatch switches generated so far in
+// each function; they are identified by the function's key and these
+// indices
+static llvm::StringMap<unsigned> branchIndices;
+static llvm::StringMap<unsigned> switchIndices;
+
+void setProfileGenerate(llvm::StringRef outputFile)
+{
+    generateEnabled = true;
+    generateOutputFile = outputFile;
+}
+
+string profileKey(InvokeEntry *entry)
+{
+    string key = getCodeName(entry);
+    // instances that only differ in which arguments are forwarded rvalues
+    // have the same name
+    for (size_t i = 0; i < entry->forwardedRValueFlags.size(); ++i) {
+        if (entry->forwardedRValueFlags[i])
+            key += " rvalue" + llvm::utostr(i);
+    }
+    return key;
+}
+
+static string functionKey(CodegenContext *ctx)
+{
+    if (!ctx->profileKey.empty())
+        return ctx->profileKey;
+    return ctx->llvmFunc->getName().str();
+}
+
+static llvm::GlobalVariable *newProfileCounter(llvm::StringRef key)
+{
+    llvm::Type *counterType = llvmIntType(64);
+    llvm::GlobalVariable *counter =
+        new llvm::GlobalVariable(*llvmModule,
+                                 counterType,
+                                 false,
+                                 llvm::GlobalVariable::InternalLinkage,
+                                 llvm::ConstantInt::get(counterType, 0),
+                                 "clayprofile_counter");
+    profileCounters.push_back(ProfileCounter(key, counter, counter));
+    return counter;
+}
+
+static void addToProfileCounter(llvm::Value *counter,
+                                llvm::Value *amount,
+                                CodegenContext *ctx)
+{
+    llvm::Value *count = ctx->builder->CreateLoad(counter);
+    ctx->builder->CreateStore(ctx->builder->CreateAdd(count, amount), counter);
+}
+
+static void applyEntryCount(CodegenContext *ctx, llvm::StringRef key);
+
+void codegenProfileFunctionEntry(CodegenContext *ctx)
+{
+    string key = functionKey(ctx);
+    // a body generated again (in the repl) numbers its branches afresh
+    branchIndices[key] = 0;
+    switchIndices[key] = 0;
+
+    if (generateEnabled) {
+        llvm::GlobalVariable *counter = newProfileCounter(key + "#entry");
+        addToProfileCounter(counter, llvm::ConstantInt::get(llvmIntType(64), 1), ctx);
+    }
+    if (useEnabled)
+        applyEntryCount(ctx, key + "#entry");
+}
+
+void codegenProfileWriterRegistration(CodegenContext *constructorsCtx)
+{
+    if (!generateEnabled)
+        return;
+
+    llvm::FunctionType *writerType =
+        llvm::FunctionType::get(llvmVoidType(), vector<llvm::Type *>(), false);
+    profileWriter = llvm::Function::Create(writerType,
+                                           llvm::Function::InternalLinkage,
+                                           "clayprofile_write",
+                                           llvmModule);
+
+    llvm::Function *atexitFunc = llvmModule->getFunction("atexit");
+    if (!atexitFunc) {
+        vector<llvm::Type*> atexitArgTypes;
+        atexitArgTypes.push_back(profileWriter->getType());
+
+        llvm::FunctionType *atexitType =
+            llvm::FunctionType::get(llvmIntType(32), atexitArgTypes, false);
+
+        atexitFunc = llvm::Function::Create(atexitType,
+            llvm::Function::ExternalLinkage,
+            "atexit",
+            llvmModule);
+    }
+
+    constructorsCtx->builder->CreateCall(atexitFunc, profileWriter);
+}
+
+static llvm::Function *declareLibcFunction(llvm::StringRef name,
+                                           llvm::Type *returnType,
+                                           llvm::ArrayRef<llvm::Type *> argTypes,
+                                           bool isVarArg)
+{
+    llvm::Function *func = llvmModule->getFunction(name);
+    if (func != NULL)
+        return func;
+    llvm::FunctionType *funcType =
+        llvm::FunctionType::get(returnType, argTypes, isVarArg);
+    return llvm::Function::Create(funcType,
+                                  llvm::Function::ExternalLinkage,
+                                  name,
+                                  llvmModule);
+}
+
+// whether code that is still in the module updates the counter
+static bool counterInUse(llvm::GlobalVariable *global)
+{
+    llvm::Value::use_iterator i, end;
+    for (i = global->use_begin(), end = global->use_end(); i != end; ++i) {
+        if (llvm::isa<llvm::Instruction>(*i))
+            return true;
+    }
+    return false;
+}
+
+void codegenProfileWriter()
+{
+    if (!generateEnabled)
+        return;
+    assert(profileWriter != NULL && profileWriter->empty());
+
+    llvm::LLVMContext &context = llvm::getGlobalContext();
+    llvm::Type *charPtrType = llvm::Type::getInt8PtrTy(context);
+
+    vector<llvm::Type *> fopenArgs(2, charPtrType);
+    llvm::Function *fopenFunc =
+        declareLibcFunction("fopen", charPtrType, fopenArgs, false);
+    vector<llvm::Type *> fprintfArgs(2, charPtrType);
+    llvm::Function *fprintfFunc =
+        declareLibcFunction("fprintf", llvmIntType(32), fprintfArgs, true);
+    vector<llvm::Type *> fcloseArgs(1, charPtrType);
+    llvm::Function *fcloseFunc =
+        declareLibcFunction("fclose", llvmIntType(32), fcloseArgs, false);
+
+    llvm::BasicBlock *entryBlock =
+        llvm::BasicBlock::Create(context, "entry", profileWriter);
+    llvm::BasicBlock *writeBlock =
+        llvm::BasicBlock::Create(context, "write", profileWriter);
+    llvm::BasicBlock *doneBlock =
+        llvm::BasicBlock::Create(context, "done", profileWriter);
+
+    llvm::IRBuilder<> builder(entryBlock);
+    llvm::Value *file = builder.CreateCall2(
+        fopenFunc,
+        builder.CreateGlobalStringPtr(generateOutputFile),
+        builder.CreateGlobalStringPtr("w"));
+    builder.CreateCondBr(builder.CreateIsNull(file), doneBlock, writeBlock);
+
+    builder.SetInsertPoint(writeBlock);
+    llvm::Value *format = builder.CreateGlobalStringPtr("%llu %s\n");
+    for (size_t i = 0; i < profileCounters.size(); ++i) {
+        // the counters of pruned bodies would only ever be written as zero
+        if (!counterInUse(profileCounters[i].global))
+            continue;
+        builder.CreateCall4(fprintfFunc,
+                            file,
+                            format,
+                            builder.CreateLoad(profileCounters[i].counter),
+                            builder.CreateGlobalStringPtr(profileCounters[i].key));
+    }
+    builder.CreateCall(fcloseFunc, file);
+    builder.CreateBr(doneBlock);
+
+    builder.SetInsertPoint(doneBlock);
+    builder.CreateRetVoid();
+}
+
+
+
+//
+// profile use
+//
+
+
+bool loadProfile(llvm::StringRef fileName, string &errorMessage)
+{
+    llvm::OwningPtr<llvm::MemoryBuffer> buffer;
+    if (llvm::error_code ec = llvm::MemoryBuffer::getFile(fileName, buffer)) {
+        errorMessage = ec.message();
+        return false;
+    }
+
+    // counts for a key that appears more than once are summed, so the
+    // outputs of several training runs can simply be concatenated
+    llvm::StringRef rest = buffer->getBuffer();
+    while (!rest.empty()) {
+        std::pair<llvm::StringRef, llvm::StringRef> split = rest.split('\n');
+        llvm::StringRef line = split.first.rtrim("\r");
+        rest = split.second;
+        if (line.empty())
+            continue;
+
+        std::pair<llvm::StringRef, llvm::StringRef> fields = line.split(' ');
+        unsigned long long count;
+        if (fields.first.getAsInteger(10, count) || fields.second.empty()) {
+            errorMessage = "malformed profile entry: " + line.str();
+            return false;
+        }
+        profileCounts[fields.second] += count;
+    }
+
+    llvm::StringMap<uint64_t>::const_iterator i, end;
+    for (i = profileCounts.begin(), end = profileCounts.end(); i != end; ++i) {
+        if (i->getKey().endswith("#entry"))
+            maxEntryCount = std::max(maxEntryCount, i->getValue());
+    }
+
+    useEnabled = true;
+    return true;
+}
+
+static bool lookupProfileCount(llvm::StringRef key, uint64_t &count)
+{
+    llvm::StringMap<uint64_t>::const_iterator i = profileCounts.find(key);
+    if (i == profileCounts.end())
+        return false;
+    count = i->getValue();
+    return true;
+}
+
+static llvm::MDNode *branchWeights(llvm::ArrayRef<uint64_t> counts)
+{
+    // branch weights are 32-bit; scale all counts down together
+    uint64_t maxCount = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+        maxCount = std::max(maxCount, counts[i]);
+    uint64_t scale = maxCount / 0xfffffffeULL + 1;
+    vector<uint32_t> weights;
+    for (size_t i = 0; i < counts.size(); ++i)
+        weights.push_back(uint32_t(counts[i] / scale) + 1);
+    llvm::MDBuilder md(llvm::getGlobalContext());
+    return md.createBranchWeights(weights);
+}
+
+void codegenProfiledCondBr(llvm::Value *cond,
+                           llvm::BasicBlock *trueBlock,
+                           llvm::BasicBlock *falseBlock,
+                           CodegenContext *ctx)
+{
+    string key;
+    if (generateEnabled || useEnabled) {
+        string function = functionKey(ctx);
+        unsigned &index = branchIndices[function];
+        key = (llvm::Twine(function) + "#" + llvm::Twine(index)).str();
+        ++index;
+    }
+
+    if (generateEnabled) {
+        llvm::Type *counterType = llvmIntType(64);
+        llvm::Value *taken = ctx->builder->CreateZExt(cond, counterType);
+        addToProfileCounter(newProfileCounter(key + "+"), taken, ctx);
+        llvm::Value *notTaken =
+            ctx->builder->CreateZExt(ctx->builder->CreateNot(cond), counterType);
+        addToProfileCounter(newProfileCounter(key + "-"), notTaken, ctx);
+    }
+
+    llvm::BranchInst *branch = ctx->builder->CreateCondBr(cond, trueBlock, falseBlock);
+
+    uint64_t counts[2];
+    if (useEnabled
+        && lookupProfileCount(key + "+", counts[0])
+        && lookupProfileCount(key + "-", counts[1]))
+    {
+        branch->setMetadata(llvm::LLVMContext::MD_prof, branchWeights(counts));
+    }
+}
+
+void codegenProfiledSwitch(llvm::Value *tag,
+                           llvm::BasicBlock *defaultBlock,
+                           llvm::ArrayRef<llvm::BasicBlock *> caseBlocks,
+                           CodegenContext *ctx)
+{
+    unsigned caseCount = unsigned(caseBlocks.size());
+    llvm::IntegerType *tagType = llvm::cast<llvm::IntegerType>(tag->getType());
+
+    // keys are "<switch>:<case>" and "<switch>:default"
+    vector<string> keys;
+    if (generateEnabled || useEnabled) {
+        string function = functionKey(ctx);
+        unsigned &index = switchIndices[function];
+        string key = (llvm::Twine(function) + "#switch"
+                      + llvm::Twine(index)).str();
+        ++index;
+        for (unsigned i = 0; i < caseCount; ++i)
+            keys.push_back((llvm::Twine(key) + ":" + llvm::Twine(i)).str());
+        keys.push_back(key + ":default");
+    }
+
+    if (generateEnabled) {
+        // one counter per case plus one for out-of-range tags, indexed by tag
+        llvm::Type *counterType = llvmIntType(64);
+        llvm::ArrayType *arrayType = llvm::ArrayType::get(counterType, caseCount + 1);
+        llvm::GlobalVariable *counters =
+            new llvm::GlobalVariable(*llvmModule,
+                                     arrayType,
+                                     false,
+                                     llvm::GlobalVariable::InternalLinkage,
+                                     llvm::ConstantAggregateZero::get(arrayType),
+                                     "clayprofile_counters");
+        for (unsigned i = 0; i <= caseCount; ++i) {
+            llvm::Constant *indices[2] = {
+                llvm::ConstantInt::get(llvmIntType(32), 0),
+                llvm::ConstantInt::get(llvmIntType(32), i)
+            };
+            profileCounters.push_back(ProfileCounter(
+                keys[i],
+                llvm::ConstantExpr::getInBoundsGetElementPtr(counters, indices),
+                counters));
+        }
+
+        llvm::Value *outOfRange = llvm::ConstantInt::get(tagType, caseCount);
+        llvm::Value *inRange = ctx->builder->CreateICmpULT(tag, outOfRange);
+        llvm::Value *slot = ctx->builder->CreateSelect(inRange, tag, outOfRange);
+        llvm::Value *indices[2] = {
+            llvm::ConstantInt::get(tagType, 0),
+            slot
+        };
+        llvm::Value *counter = ctx->builder->CreateInBoundsGEP(counters, indices);
+        addToProfileCounter(counter, llvm::ConstantInt::get(counterType, 1), ctx);
+    }
+
+    llvm::SwitchInst *switchInst =
+        ctx->builder->CreateSwitch(tag, defaultBlock, caseCount);
+    for (unsigned i = 0; i < caseCount; ++i)
+        switchInst->addCase(llvm::ConstantInt::get(tagType, i), caseBlocks[i]);
+
+    if (useEnabled) {
+        // weights list the default destination first, then each case
+        vector<uint64_t> counts(caseCount + 1);
+        if (!lookupProfileCount(keys[caseCount], counts[0]))
+            return;
+        for (unsigned i = 0; i < caseCount; ++i) {
+            if (!lookupProfileCount(keys[i], counts[i + 1]))
+                return;
+        }
+        switchInst->setMetadata(llvm::LLVMContext::MD_prof, branchWeights(counts));
+    }
+}
+
+// procedures entered at least 1% as often as the hottest one are hinted
+// for inlining; procedures never entered in training are optimized for
+// size
+static void applyEntryCount(CodegenContext *ctx, llvm::StringRef key)
+{
+    uint64_t count;
+    if (maxEntryCount == 0 || !lookupProfileCount(key, count))
+        return;
+    llvm::Function *f = ctx->llvmFunc;
+    uint64_t hotThreshold = maxEntryCount / 100 + 1;
+    if (count == 0)
+        f->addFnAttr(llvm::Attributes::OptimizeForSize);
+    else if (count >= hotThreshold
+             && !f->getFnAttributes().hasAttribute(llvm::Attributes::NoInline))
+        f->addFnAttr(llvm::Attributes::InlineHint);
+}
+
+}
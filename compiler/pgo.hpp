@@ -0,0 +1,41 @@
+#pragma once
+
+
+#include "clay.hpp"
+#include "codegen.hpp"
+
+namespace clay {
+
+
+//
+// instrumentation-based profile guided optimization
+//
+// -profile-generate counts procedure entries, the outcomes of `if` and
+// `while` conditions and the tags seen by variant dispatch; the counts are
+// written out at exit as lines of "<count> <key>". -profile-use reads such
+// a file back and attaches branch weights and hot/cold function attributes.
+//
+// keys start with the procedure's Clay name and argument types rather than
+// its LLVM name, which LLVM makes unique by numbering in the order that
+// functions happen to be generated.
+//
+
+void setProfileGenerate(llvm::StringRef outputFile);
+string profileKey(InvokeEntry *entry);
+bool loadProfile(llvm::StringRef fileName, string &errorMessage);
+
+void codegenProfileFunctionEntry(CodegenContext *ctx);
+void codegenProfiledCondBr(llvm::Value *cond,
+                           llvm::BasicBlock *trueBlock,
+                           llvm::BasicBlock *falseBlock,
+                           CodegenContext *ctx);
+void codegenProfiledSwitch(llvm::Value *tag,
+                           llvm::BasicBlock *defaultBlock,
+                           llvm::ArrayRef<llvm::BasicBlock *> caseBlocks,
+                           CodegenContext *ctx);
+
+void codegenProfileWriterRegistration(CodegenContext *constructorsCtx);
+// after unreachable bodies are pruned, so that their counters are left out
+void codegenProfileWriter();
+
+}
@@ -1090,6 +1090,8 @@ llvm::StructType *llvmStaticType() {
 }
 
 llvm::DIType llvmTypeDebugInfo(TypePtr t) {
+    if (!fullDebugInfo())
+        return llvm::DIType(NULL);
     if (t->llType == NULL)
         declareLLVMType(t);
 
@@ -1108,7 +1110,7 @@ static void declareLLVMType(TypePtr t) {
     switch (t->typeKind) {
     case BOOL_TYPE : {
         t->llType = llvmIntType(1);
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createBasicType(
                 typeName(t),
                 debugTypeSize(t->llType),
@@ -1119,7 +1121,7 @@ static void declareLLVMType(TypePtr t) {
     case INTEGER_TYPE : {
         IntegerType *x = (IntegerType *)t.ptr();
         t->llType = llvmIntType(x->bits);
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createBasicType(
                 typeName(t),
                 debugTypeSize(t->llType),
@@ -1130,7 +1132,7 @@ static void declareLLVMType(TypePtr t) {
     case FLOAT_TYPE : {
         FloatType *x = (FloatType *)t.ptr();
         t->llType = llvmFloatType(x->bits);
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createBasicType(
                 typeName(t),
                 debugTypeSize(t->llType),
@@ -1145,7 +1147,7 @@ static void declareLLVMType(TypePtr t) {
         llTypes.push_back(llvmType(realT));
         llTypes.push_back(llvmType(imagT));
         t->llType = llvm::StructType::create(llvm::getGlobalContext(), llTypes, typeName(t));
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createBasicType(
                 typeName(t),
                 debugTypeSize(t->llType),
@@ -1157,7 +1159,7 @@ static void declareLLVMType(TypePtr t) {
     case POINTER_TYPE : {
         PointerType *x = (PointerType *)t.ptr();
         t->llType = llvmPointerType(x->pointeeType);
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createPointerType(
                 llvmTypeDebugInfo(x->pointeeType),
                 debugTypeSize(t->llType),
@@ -1180,7 +1182,7 @@ static void declareLLVMType(TypePtr t) {
         llvm::FunctionType *llFuncType =
             llvm::FunctionType::get(exceptionReturnType(), llArgTypes, false);
         t->llType = llvm::PointerType::getUnqual(llFuncType);
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             vector<llvm::Value*> debugParamTypes;
             debugParamTypes.push_back(llvmVoidTypeDebugInfo());
             for (size_t i = 0; i < x->argTypes.size(); ++i) {
@@ -1242,7 +1244,7 @@ static void declareLLVMType(TypePtr t) {
             t->llType = llvm::PointerType::getUnqual(llOpaqueFuncType);
         }
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::SmallVector<llvm::Value*,16> debugParamTypes;
             debugParamTypes.push_back(x->returnType == NULL
                 ? llvmVoidTypeDebugInfo()
@@ -1270,7 +1272,7 @@ static void declareLLVMType(TypePtr t) {
     case ARRAY_TYPE : {
         ArrayType *x = (ArrayType *)t.ptr();
         t->llType = llvmArrayType(x->elementType, x->size);
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::Value* elementRange = llvmDIBuilder->getOrCreateSubrange(
                 0,
                 x->size - 1);
@@ -1287,7 +1289,7 @@ static void declareLLVMType(TypePtr t) {
     case VEC_TYPE : {
         VecType *x = (VecType *)t.ptr();
         t->llType = llvm::VectorType::get(llvmType(x->elementType), x->size);
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::Value* elementRange = llvmDIBuilder->getOrCreateSubrange(
                 0,
                 x->size - 1);
@@ -1303,19 +1305,19 @@ static void declareLLVMType(TypePtr t) {
     }
     case TUPLE_TYPE : {
         t->llType = llvm::StructType::create(llvm::getGlobalContext(), typeName(t));
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createTemporaryType();
         break;
     }
     case UNION_TYPE : {
         t->llType = llvm::StructType::create(llvm::getGlobalContext(), typeName(t));
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createTemporaryType();
         break;
     }
     case RECORD_TYPE : {
         t->llType = llvm::StructType::create(llvm::getGlobalContext(), typeName(t));
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createTemporaryType();
         break;
     }
@@ -1325,13 +1327,13 @@ static void declareLLVMType(TypePtr t) {
         if (!reprType->llType)
             declareLLVMType(reprType);
         t->llType = reprType->llType;
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createTemporaryType();
         break;
     }
     case STATIC_TYPE : {
         t->llType = llvmStaticType();
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createBasicType(
                 typeName(t),
                 debugTypeSize(t->llType),
@@ -1341,7 +1343,7 @@ static void declareLLVMType(TypePtr t) {
     }
     case ENUM_TYPE : {
         t->llType = llvmType(cIntType);
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             EnumType *en = (EnumType*)t.ptr();
             llvm::SmallVector<llvm::Value*,16> enumerators;
             for (vector<EnumMemberPtr>::const_iterator i = en->enumeration->members.begin(),
@@ -1375,7 +1377,7 @@ static void declareLLVMType(TypePtr t) {
         if (!reprType->llType)
             declareLLVMType(reprType);
         t->llType = reprType->llType;
-        if (llvmDIBuilder != NULL)
+        if (fullDebugInfo())
             t->debugInfo = (llvm::MDNode*)llvmDIBuilder->createTemporaryType();
         break;
     }
@@ -1416,7 +1418,7 @@ static void defineLLVMType(TypePtr t) {
 
         theType->setBody(llTypes);
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::TrackingVH<llvm::MDNode> placeholderNode = (llvm::MDNode*)x->getDebugInfo();
             llvm::DIType placeholder(placeholderNode);
 
@@ -1499,7 +1501,7 @@ static void defineLLVMType(TypePtr t) {
 
         theType->setBody(llTypes);
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::TrackingVH<llvm::MDNode> placeholderNode = (llvm::MDNode*)x->getDebugInfo();
             llvm::DIType placeholder(placeholderNode);
 
@@ -1559,7 +1561,7 @@ static void defineLLVMType(TypePtr t) {
 
         theType->setBody(llTypes);
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::TrackingVH<llvm::MDNode> placeholderNode = (llvm::MDNode*)x->getDebugInfo();
             llvm::DIType placeholder(placeholderNode);
             llvm::ArrayRef<IdentifierPtr> fieldNames = recordFieldNames(x);
@@ -1673,7 +1675,7 @@ static void defineLLVMType(TypePtr t) {
         if (!reprType->defined)
             defineLLVMType(reprType);
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::TrackingVH<llvm::MDNode> placeholderNode = (llvm::MDNode*)x->getDebugInfo();
             
             llvm::DIType(placeholderNode).replaceAllUsesWith(llvmTypeDebugInfo(reprType));
@@ -1688,7 +1690,7 @@ static void defineLLVMType(TypePtr t) {
         if (!reprType->defined)
             defineLLVMType(reprType);
 
-        if (llvmDIBuilder != NULL) {
+        if (fullDebugInfo()) {
             llvm::TrackingVH<llvm::MDNode> placeholderNode = (llvm::MDNode*)x->getDebugInfo();
             
             llvm::DIType(placeholderNode).replaceAllUsesWith(llvmTypeDebugInfo(reprType));
@@ -0,0 +1,45 @@
+from subprocess import Popen, PIPE
+from sys import argv
+import os
+import re
+
+# runs the compiler under test with the suite's build flags, for tests of
+# what the compiler itself reports or emits
+def clay(*args):
+    commandline = [os.environ['CLAY']] + argv[2:] + list(args)
+    process = Popen(commandline, stdout=PIPE, stderr=PIPE)
+    out, err = process.communicate()
+    if process.returncode != 0:
+        print "!! clay exited with", process.returncode, ":", " ".join(args)
+        print err
+    return out, err
+
+# runs the compiler on a program that is expected not to compile, returning
+# its errors as "<file name>:<line>: <message>"
+def clayErrors(*args):
+    commandline = [os.environ['CLAY']] + argv[2:] + list(args)
+    process = Popen(commandline, stdout=PIPE, stderr=PIPE)
+    out, err = process.communicate()
+    if process.returncode == 0:
+        print "!! clay succeeded:", " ".join(args)
+    errors = []
+    for line in err.splitlines():
+        match = re.match(r'(.*)\((\d+),\d+\): error: (.*)$', line)
+        if match:
+            errors.append("%s:%s: %s" % (os.path.basename(match.group(1)),
+                                         match.group(2), match.group(3)))
+    return errors
+
+def run(*commandline):
+    process = Popen(list(commandline), stdout=PIPE, stderr=PIPE)
+    out, err = process.communicate()
+    if process.returncode != 0:
+        print "!! error code", process.returncode, ":", " ".join(commandline)
+    return out
+
+# for tests that write or change the program's sources as they go; their
+# main.clay is only there for the test runner to find
+def write(fileName, text):
+    f = open(fileName, 'w')
+    f.write(text)
+    f.close()
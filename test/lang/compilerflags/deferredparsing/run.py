@@ -0,0 +1,17 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay, clayErrors, run
+
+# the malformed body of `unused` is skipped
+clay('-o', 'temp.exe', 'main.clay')
+sys.stdout.write(run('./temp.exe'))
+
+print "with -no-deferred-parsing:"
+for error in clayErrors('-no-deferred-parsing', '-o', 'temp.exe', 'main.clay'):
+    print error
+
+# a called body is parsed when it is first used, and its errors point into
+# the module that defines it
+print "calling a malformed body:"
+for error in clayErrors('-o', 'temp-calls.exe', 'calls.clay'):
+    print error
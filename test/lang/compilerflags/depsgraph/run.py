@@ -0,0 +1,41 @@
+import os
+import sys
+from subprocess import Popen, PIPE
+sys.path.append('..')
+from compilerflags import clay, write
+
+def writeHelpers(usedBody, unusedBody, extra=''):
+    write('temp_helpers.clay',
+          'used() {\n    return %s;\n}\n\nunused() {\n    return %s;\n}\n%s'
+          % (usedBody, unusedBody, extra))
+
+# -check-deps reports a needed rebuild with exit status 1, so it is not
+# run through clay()
+def checkDeps(what, *changedFiles):
+    commandline = [os.environ['CLAY'], '-check-deps', 'temp.graph'] + list(changedFiles)
+    process = Popen(commandline, stdout=PIPE, stderr=PIPE)
+    out, err = process.communicate()
+    print what + ":", "rebuild" if process.returncode == 1 else "no rebuild",
+    if 'used in' in out:
+        print "(used changed)"
+    elif 'declarations in' in out:
+        print "(declarations changed)"
+    else:
+        print
+
+write('temp_main.clay', 'import temp_helpers.*;\n\nmain() {\n    println(used());\n}\n')
+writeHelpers('1', '2')
+clay('-deps-graph', 'temp.graph', '-o', 'temp.exe', 'temp_main.clay')
+
+checkDeps("nothing changed")
+
+writeHelpers('1', '3')
+checkDeps("unused body changed")
+
+writeHelpers('4', '2')
+checkDeps("used body changed")
+
+writeHelpers('1', '2', '\nadded() {\n    return 5;\n}\n')
+checkDeps("declaration added")
+checkDeps("declaration added, only main listed", 'temp_main.clay')
+checkDeps("declaration added, helpers listed", 'temp_helpers.clay')
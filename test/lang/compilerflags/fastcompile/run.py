@@ -0,0 +1,15 @@
+import re
+import sys
+sys.path.append('..')
+from compilerflags import clay, run
+
+for flags in [('-Ofast-compile',), ('-Ofast-compile', '-g')]:
+    print " ".join(flags) + ":"
+    clay(*(flags + ('-o', 'temp.exe', 'main.clay')))
+    sys.stdout.write(run('./temp.exe'))
+
+# with -g, -Ofast-compile still only emits line tables
+clay('-Ofast-compile', '-g', '-emit-llvm', '-S', '-o', 'temp.ll', 'main.clay')
+ll = open('temp.ll').read()
+print "line locations:", re.search(r'!dbg !\d+', ll) is not None
+print "variables:", '@llvm.dbg.declare' in ll
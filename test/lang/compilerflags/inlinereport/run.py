@@ -0,0 +1,17 @@
+import re
+import sys
+sys.path.append('..')
+from compilerflags import clay, run
+
+out, err = clay('-inline-report', '-o', 'temp.exe', 'main.clay')
+sys.stdout.write(run('./temp.exe'))
+
+def inlined(name):
+    pattern = re.compile(r'^inline: (.*\.)?' + re.escape(name) + r'\(')
+    return len([l for l in err.splitlines() if pattern.match(l)])
+
+print "sumOf inlined:", inlined('sumOf')
+print "addCoordinates inlined:", inlined('addCoordinates')
+# once into main and once into its own body, each time stopping at the
+# recursive call
+print "spin inlined:", inlined('spin')
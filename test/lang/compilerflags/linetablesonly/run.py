@@ -0,0 +1,25 @@
+import re
+import sys
+sys.path.append('..')
+from compilerflags import clay
+
+# tags of local, argument and global variable descriptors
+variableTags = r'metadata !\{i32 (786688|786689|786484),'
+
+def debugInfo(*flags):
+    clay(*(flags + ('-emit-llvm', '-S', '-o', 'temp.ll', 'main.clay')))
+    ll = open('temp.ll').read()
+    lines = set()
+    for node in set(re.findall(r'!dbg !(\d+)', ll)):
+        location = re.search(r'^!%s = metadata !\{i32 (\d+), ' % node, ll, re.M)
+        if location:
+            lines.add(int(location.group(1)))
+    variables = re.search(variableTags, ll) is not None \
+        or '@llvm.dbg.declare' in ll
+    return lines, variables
+
+for flags in [('-g',), ('-gline-tables-only',), ('-gline-tables-only', '-g')]:
+    lines, variables = debugInfo(*flags)
+    print " ".join(flags) + ":",
+    print "statement lines:", all(line in lines for line in [4, 5, 6]),
+    print "variables:", variables
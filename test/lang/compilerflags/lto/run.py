@@ -0,0 +1,20 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay, run
+
+clay('-emit-llvm', '-o', 'temp-main.bc', 'main.clay')
+clay('-emit-llvm', '-o', 'temp-square.bc', 'square.clay')
+clay('-lto', 'temp-main.bc', 'temp-square.bc', '-o', 'temp-lto.exe')
+sys.stdout.write(run('./temp-lto.exe'))
+
+# symbols defined by `external` stay exported from a linked executable
+def exportsSquare(fileName):
+    for line in run('nm', fileName).splitlines():
+        if line.endswith('ltoSquare') and ' T ' in line:
+            return True
+    return False
+print "executable exports ltoSquare:", exportsSquare('temp-lto.exe')
+
+# -c output is not a whole program, so nothing is internalized
+clay('-lto', 'temp-main.bc', 'temp-square.bc', '-c', '-o', 'temp-lto.o')
+print "object exports ltoSquare:", exportsSquare('temp-lto.o')
@@ -0,0 +1,11 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay
+
+def flipDefinitions(*flags):
+    clay(*(flags + ('-O0', '-emit-llvm', '-S', '-o', 'temp.ll', 'main.clay')))
+    lines = open('temp.ll').read().splitlines()
+    return len([l for l in lines if l.startswith('define') and 'flip' in l])
+
+print "without -merge-functions:", flipDefinitions()
+print "with -merge-functions:", flipDefinitions('-merge-functions')
@@ -0,0 +1,31 @@
+import os
+import shutil
+import sys
+import time
+sys.path.append('..')
+from compilerflags import clay, run, write
+
+if os.path.isdir('temp-lib'):
+    shutil.rmtree('temp-lib')
+os.mkdir('temp-lib')
+write(os.path.join('temp-lib', 'temp_indexed.clay'), 'indexed() = 1;\n')
+clay('-write-module-index', 'temp-lib')
+
+# make the index older than the modules added after it, without waiting
+# for the clock to pass a second
+index = os.path.join('temp-lib', 'clay-modules.index')
+past = time.time() - 60
+os.utime(index, (past, past))
+
+# a new module in an indexed directory, and one in a new directory
+write(os.path.join('temp-lib', 'temp_added.clay'), 'added() = 2;\n')
+os.mkdir(os.path.join('temp-lib', 'temp_subdir'))
+write(os.path.join('temp-lib', 'temp_subdir', 'temp_subdir.clay'), 'subdir() = 3;\n')
+
+write('temp_main.clay',
+      'import temp_indexed.*;\nimport temp_added.*;\nimport temp_subdir.*;\n\n'
+      'main() {\n    println(indexed(), " ", added(), " ", subdir());\n}\n')
+clay('-Itemp-lib', '-o', 'temp-main.exe', 'temp_main.clay')
+sys.stdout.write(run('./temp-main.exe'))
+
+shutil.rmtree('temp-lib')
@@ -0,0 +1,26 @@
+import re
+import sys
+sys.path.append('..')
+from compilerflags import clay, run
+
+clay('-o', 'temp.exe', 'main.clay')
+sys.stdout.write(run('./temp.exe'))
+
+# the exception check after a call tests the result through llvm.expect
+def checkedCalls(name, *flags):
+    clay(*(flags + ('-O0', '-emit-llvm', '-S', '-o', 'temp.ll', 'main.clay')))
+    lines = open('temp.ll').read().splitlines()
+    call = re.compile(r'call .*@"?[^"(]*\b' + name + r'\(')
+    calls = checks = 0
+    for i in range(len(lines)):
+        if call.search(lines[i]):
+            calls += 1
+            if any('@llvm.expect' in l for l in lines[i + 1:i + 4]):
+                checks += 1
+    return "%d of %d" % (checks, calls)
+
+print "square checked:", checkedCalls('square')
+print "positive checked:", checkedCalls('positive')
+print "checked checked:", checkedCalls('checked')
+print "square checked without propagation:", \
+    checkedCalls('square', '-no-nothrow-propagation')
@@ -0,0 +1,17 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay, run
+
+clay('-profile-generate=temp-profile.txt', '-o', 'temp-instrumented.exe', 'main.clay')
+sys.stdout.write(run('./temp-instrumented.exe'))
+
+# counters are keyed on Clay names, so main's entry count is found by name
+for line in open('temp-profile.txt'):
+    count, key = line.rstrip('\n').split(' ', 1)
+    if 'main(' in key and key.endswith('#entry'):
+        print "main entered:", count
+
+clay('-profile-use=temp-profile.txt', '-emit-llvm', '-S', '-o', 'temp.ll', 'main.clay')
+ll = open('temp.ll').read()
+# the `if` is taken 10 times out of 100; weights are counts plus one
+print "if weights:", '!"branch_weights", i32 11, i32 91}' in ll
@@ -0,0 +1,24 @@
+from subprocess import Popen, PIPE
+from sys import argv
+import os
+import sys
+
+# each line is a separate input; a global is initialized by the first input
+# that uses it, and never again
+inputs = """var a = noisy("a");
+var b = noisy("b") + a;
+bump() { a +: 1; return a; }
+bump()
+bump()
+println(a, " ", b);
+b
+:q
+"""
+
+commandline = [os.environ['CLAY']] + argv[2:] + ['-repl', 'main.clay']
+process = Popen(commandline, stdin=PIPE, stdout=PIPE, stderr=PIPE)
+out, err = process.communicate(inputs)
+if process.returncode != 0:
+    print "!! clay -repl exited with", process.returncode
+    print err
+sys.stdout.write(out)
@@ -0,0 +1,8 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay
+
+out, err = clay('-report-unreachable', '-o', 'temp.exe', 'main.clay')
+reported = [line for line in err.splitlines() if line.startswith('unreachable: ')]
+print "doNothing reported:", any('doNothing' in line for line in reported)
+print "used reported:", any('used' in line for line in reported)
@@ -0,0 +1,46 @@
+import os
+import shutil
+import sys
+sys.path.append('..')
+from compilerflags import clay, write
+
+def runCached():
+    out, err = clay('-v', '-run-cache-dir', 'temp-cache', '-run', 'temp_main.clay')
+    print out.strip(), "cached:", 'run cache: using' in err
+
+write('temp_main.clay', 'import temp_greeting.*;\nmain() { println(greeting()); }\n')
+write('temp_greeting.clay', 'greeting() = 1;\n')
+runCached()
+runCached()
+
+# a changed source file
+write('temp_greeting.clay', 'greeting() = 2;\n')
+runCached()
+runCached()
+
+# a changed search path, under which another module shadows the one loaded
+if not os.path.isdir('temp-shadow'):
+    os.mkdir('temp-shadow')
+write(os.path.join('temp-shadow', 'temp_greeting.clay'), 'greeting() = 3;\n')
+os.environ['CLAY_PATH'] = 'temp-shadow'
+runCached()
+runCached()
+
+# with the search path unchanged, a platform specific variant of the module
+# added next to it
+osGroup = 'windows' if sys.platform in ('win32', 'cygwin') else 'unix'
+write(os.path.join('temp-shadow', 'temp_greeting.%s.clay' % osGroup),
+      'greeting() = 4;\n')
+runCached()
+runCached()
+
+# and a module directory, which takes precedence in every search path entry
+if not os.path.isdir('temp_greeting'):
+    os.mkdir('temp_greeting')
+write(os.path.join('temp_greeting', 'temp_greeting.clay'), 'greeting() = 5;\n')
+runCached()
+runCached()
+
+shutil.rmtree('temp-cache')
+shutil.rmtree('temp-shadow')
+shutil.rmtree('temp_greeting')
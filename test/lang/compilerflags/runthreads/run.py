@@ -0,0 +1,10 @@
+import sys
+sys.path.append('..')
+from compilerflags import clay
+
+# the program starts threads, so it is compiled in full before running
+# either way
+out, err = clay('-run', 'main.clay')
+sys.stdout.write(out)
+out, err = clay('-no-lazy-compilation', '-run', 'main.clay')
+sys.stdout.write(out)
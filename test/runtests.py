@@ -526,6 +526,8 @@ def main() :
         opt.clayCompiler = os.path.abspath(args.clayCompiler)
     else:
         opt.clayCompiler = getClayCompiler(opt)
+    # run.py scripts that test compiler flags find the compiler here
+    os.environ['CLAY'] = opt.clayCompiler
 
     startTime = time.time()
     opt.clayPlatform = getClayPlatform(opt)